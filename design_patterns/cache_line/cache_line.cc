@@ -1,4 +1,5 @@
 #include <benchmark/benchmark.h>
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <vector>
@@ -8,6 +9,8 @@
 #include <numeric>
 #include <random>
 
+#include "sharded_counter.h"
+
 // ==================== Benchmark for Direct Sharing ====================
 // WRONG: Atomic Contention
 /*
@@ -311,5 +314,38 @@ static void BM_Adjacent_Conflict_128(benchmark::State& state) {
 }
 BENCHMARK(BM_Adjacent_Conflict_128)->Arg(10000000)->Threads(2);
 
+// ==================== Benchmark for Sharded Counters ====================
+// RIGHT: a statistic every thread bumps, without the contention
+/*
+    Every thread adds to the same counter, as every thread on the hot path
+    would bump the same statistic. The single atomic serialises all of
+    them (BM_DirectSharing again); ShardedCounter's threads each add to
+    their own slot and the throughput grows with the number of cores.
+    The value is read once at the end, as a reporter would.
+*/
+static std::atomic<int64_t> g_shared_counter{0};
+
+static void BM_SharedAtomicCounter(benchmark::State& state) {
+    for (auto _ : state) {
+        g_shared_counter.fetch_add(1, std::memory_order_relaxed);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedAtomicCounter)->ThreadRange(1, std::max(1u, std::thread::hardware_concurrency()))->UseRealTime();
+
+template <ShardBy By>
+static void BM_ShardedCounter(benchmark::State& state) {
+    static ShardedCounter<By> counter;
+    for (auto _ : state) {
+        counter.add();
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        benchmark::DoNotOptimize(counter.read());
+    }
+}
+BENCHMARK_TEMPLATE(BM_ShardedCounter, ShardBy::Thread)->ThreadRange(1, std::max(1u, std::thread::hardware_concurrency()))->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ShardedCounter, ShardBy::Cpu)->ThreadRange(1, std::max(1u, std::thread::hardware_concurrency()))->UseRealTime();
+
 // Main macro for the benchmark
 BENCHMARK_MAIN();
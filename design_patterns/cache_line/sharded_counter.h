@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sched.h>
+
+// Statistics counter that scales with the cores
+/*
+    -   One std::atomic incremented by every thread is BM_DirectSharing:
+        each increment takes the line from whichever core had it last.
+        Per-thread counters packed together are BM_FalseSharing. The fix is
+        BM_NoSharing's, packaged: one slot per shard, each on its own pair of
+        cache lines (128 bytes, so the adjacent line prefetcher does not
+        pair two slots either, see BM_Adjacent_Conflict_64).
+
+    -   add() is a relaxed fetch_add on the caller's slot. The slot is
+        almost always in the caller's cache already, so that costs an
+        uncontended locked add, no coherence traffic. Slots are still
+        atomic: two threads can end up on one slot (more threads than
+        slots, or a migration between picking the slot and adding).
+
+    -   read() sums the slots with relaxed loads: lazily, and only when
+        somebody asks, e.g. a metrics reporter once a second. It is not a
+        snapshot: adds that race with it may or may not be counted, but
+        each is counted exactly once eventually.
+
+    -   ShardBy::Cpu picks the slot of the CPU the caller runs on
+        (sched_getcpu(), which glibc 2.35+ reads from the rseq area
+        without a system call); threads then only share a slot while one
+        of them is preempted. ShardBy::Thread gives each thread a slot of
+        its own, round robin, and needs no call at all.
+*/
+enum class ShardBy
+{
+    Thread,
+    Cpu,
+};
+
+template <ShardBy By = ShardBy::Cpu, size_t Shards = 64>
+class ShardedCounter
+{
+    static_assert((Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+
+public:
+    static constexpr size_t kSlotAlignment = 128;
+
+    void add(int64_t value = 1)
+    {
+        slots_[shard()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    int64_t read() const
+    {
+        int64_t sum = 0;
+        for (const Slot& slot : slots_)
+        {
+            sum += slot.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+private:
+    struct alignas(kSlotAlignment) Slot
+    {
+        std::atomic<int64_t> value{0};
+    };
+
+    static size_t shard()
+    {
+        if constexpr (By == ShardBy::Cpu)
+        {
+            const int cpu = sched_getcpu();
+            return cpu < 0 ? 0 : static_cast<size_t>(cpu) & (Shards - 1);
+        }
+        else
+        {
+            static std::atomic<size_t> next_shard{0};
+            thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) & (Shards - 1);
+            return shard;
+        }
+    }
+
+    std::array<Slot, Shards> slots_;
+};
@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+#include <absl/container/flat_hash_map.h>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+
+#include "concurrent_map.h"
+#include "shared_fixture.h"
+#include "spin_lock.h"
+
+// Note
+/*
+    An order book's id index: every thread adds new orders, looks up
+    recent ones, its own and other threads', and removes the oldest, so
+    the map stays at about kLiveOrdersPerThread per thread. Per order:
+    one insert, kLookupsPerOrder finds and one erase.
+
+    -   SpinLockMap: absl::flat_hash_map behind the project's SpinLock;
+        finds queue up behind the writers like everything else.
+    -   SharedMutexMap: the same behind std::shared_mutex; finds share the
+        lock, but each still writes the lock word, a line every thread
+        contends for.
+    -   ConcurrentHashMap: finds write nothing shared, and writes
+        contend only on the cell they change. The map starts small, so the
+        run includes its resizes.
+*/
+constexpr uint64_t kLiveOrdersPerThread = 1 << 12;
+constexpr uint64_t kLookupsPerOrder = 8;
+
+template <typename Lock, typename SharedGuard>
+class LockedMap
+{
+public:
+    bool insert(uint64_t key, uint64_t value)
+    {
+        std::lock_guard<Lock> guard(lock_);
+        return map_.emplace(key, value).second;
+    }
+
+    bool erase(uint64_t key)
+    {
+        std::lock_guard<Lock> guard(lock_);
+        return map_.erase(key) != 0;
+    }
+
+    std::optional<uint64_t> find(uint64_t key)
+    {
+        SharedGuard guard(lock_);
+        const auto it = map_.find(key);
+        return it != map_.end() ? std::optional<uint64_t>(it->second) : std::nullopt;
+    }
+
+private:
+    Lock lock_;
+    absl::flat_hash_map<uint64_t, uint64_t> map_;
+};
+
+using SpinLockMap = LockedMap<SpinLock, std::lock_guard<SpinLock>>;
+using SharedMutexMap = LockedMap<std::shared_mutex, std::shared_lock<std::shared_mutex>>;
+
+// Order ids are per thread: the thread index above bit 40, a sequence below
+template <typename Map>
+void order_lifecycle(benchmark::State& state, Map& map)
+{
+    const uint64_t threads = state.threads();
+    const uint64_t thread = state.thread_index();
+    uint64_t sequence = 0;
+    uint64_t hits = 0;
+
+    for (auto _ : state)
+    {
+        ++sequence;
+        map.insert((thread + 1) << 40 | sequence, sequence);
+
+        for (uint64_t i = 0; i < kLookupsPerOrder; ++i)
+        {
+            const uint64_t owner = (thread + i) % threads;
+            const uint64_t recent = sequence - (sequence * 7 + i * 131) % std::min(sequence, kLiveOrdersPerThread);
+            hits += map.find((owner + 1) << 40 | recent).has_value();
+        }
+
+        if (sequence > kLiveOrdersPerThread)
+        {
+            map.erase((thread + 1) << 40 | (sequence - kLiveOrdersPerThread));
+        }
+    }
+
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations() * (kLookupsPerOrder + 2));
+}
+
+SHARED_BENCHMARK(SpinLockMap, order_lifecycle, SpinLockMap)->ThreadRange(1, 16);
+
+SHARED_BENCHMARK(SharedMutexMap, order_lifecycle, SharedMutexMap)->ThreadRange(1, 16);
+
+SHARED_BENCHMARK(ConcurrentHashMap, order_lifecycle, ConcurrentHashMap)->ThreadRange(1, 16);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "../memory_reclamation/epoch.h"
+#include "spin_lock.h"
+
+// Concurrent open addressing map from 64 bit keys (e.g. order ids) to
+// 64 bit values
+/*
+    -   A cell is two atomic words, key and value. A key is claimed once
+        with a compare-exchange on the empty key and then never changes, so
+        a probe sequence never changes under a reader either. Everything
+        after that happens on the value: insert and assign replace it,
+        erase() replaces it with a tombstone. find() is loads only; no
+        operation writes anything shared but the one cell it is about.
+
+    -   Linear probing with Fibonacci hashing, which spreads sequential ids
+        (see OrderTable). Tombstones keep their key and count as occupied,
+        so they lengthen probes until the next resize drops them.
+
+    -   Resize: an insert that would have to claim a cell more than
+        kProbeLimit cells from its home starts a new table, sized for four
+        times the live entries, at least as large as the old one. Every
+        thread that then touches the old table helps migrate it a chunk of
+        kMigrationChunk cells at a time: freeze a cell's value so that
+        nobody can change it, copy it to the new table unless it is a
+        tombstone, then mark it moved. Operations that run into a frozen or
+        moved cell help finish the migration and retry in the new table;
+        find() just reads through. The last helper swings the map to the
+        new table and retires the old one through the EpochDomain.
+
+    -   Progress: insert, find and erase are lock-free except during a
+        resize. Only a chunk's owner copies its cells, so that no late
+        copy can resurrect an entry erased in the new table; helpers wait
+        for the owners of chunks still in flight.
+
+    Key 0 marks an empty cell and values above kMaxValue are the cell
+    states, so neither can be stored: every operation throws
+    std::invalid_argument for key 0, and insertion for such a value.
+*/
+class ConcurrentHashMap
+{
+public:
+    static constexpr uint64_t kMaxValue = (uint64_t{1} << 62) - 1;
+    static constexpr size_t kProbeLimit = 32;
+    static constexpr size_t kMigrationChunk = 1024;
+
+    explicit ConcurrentHashMap(size_t capacity = 1024, EpochDomain& domain = default_epoch_domain())
+        : domain_(domain), table_(new Table(std::bit_ceil(std::max<size_t>(capacity, kProbeLimit)), 0))
+    {
+    }
+
+    // No other thread may use the map anymore
+    ~ConcurrentHashMap()
+    {
+        for (Table* table = table_.load(std::memory_order_relaxed); table != nullptr;)
+        {
+            delete std::exchange(table, table->next.load(std::memory_order_relaxed));
+        }
+    }
+
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+    // false, and no change, if key is present
+    bool insert(uint64_t key, uint64_t value)
+    {
+        check_key(key);
+        check_value(value);
+        return update(key, value, Mode::InsertIfAbsent);
+    }
+
+    void insert_or_assign(uint64_t key, uint64_t value)
+    {
+        check_key(key);
+        check_value(value);
+        update(key, value, Mode::Assign);
+    }
+
+    // false if key is not present
+    bool erase(uint64_t key)
+    {
+        check_key(key);
+        return update(key, kTombstone, Mode::Erase);
+    }
+
+    std::optional<uint64_t> find(uint64_t key)
+    {
+        check_key(key);
+        EpochDomain::Guard guard = domain_.pin();
+        Table* table = table_.load(std::memory_order_acquire);
+        while (true)
+        {
+            const Cell* cell = table->probe(key);
+            const uint64_t value = cell ? cell->value.load(std::memory_order_acquire) : kUnset;
+            if (value == kMoved || (cell && cell->key.load(std::memory_order_relaxed) == kEmptyKey && (value & kFrozen)))
+            {
+                // Moved on, or empty but frozen: an insert may have gone ahead
+                table = table->next.load(std::memory_order_acquire);
+                continue;
+            }
+
+            const uint64_t unfrozen = value & ~kFrozen;
+            if (cell == nullptr || !is_value(unfrozen) || cell->key.load(std::memory_order_relaxed) != key)
+            {
+                return std::nullopt;
+            }
+            return unfrozen;
+        }
+    }
+
+    size_t capacity() const
+    {
+        return table_.load(std::memory_order_acquire)->capacity;
+    }
+
+private:
+    static constexpr uint64_t kEmptyKey = 0;
+
+    // Values above kMaxValue; kFrozen is a flag on top of any value
+    static constexpr uint64_t kTombstone = kMaxValue + 1;    // erased
+    static constexpr uint64_t kUnset = kMaxValue + 2;        // key claimed, no value yet
+    static constexpr uint64_t kMoved = kMaxValue + 3;        // copied to the next table
+    static constexpr uint64_t kFrozen = uint64_t{1} << 63;
+
+    enum class Mode
+    {
+        InsertIfAbsent,
+        Assign,
+        Erase,
+    };
+
+    struct Cell
+    {
+        std::atomic<uint64_t> key{kEmptyKey};
+        std::atomic<uint64_t> value{kUnset};
+    };
+
+    struct Table
+    {
+        Table(size_t capacity, uint64_t seed)
+            : capacity(capacity), mask(capacity - 1), shift(64 - std::countr_zero(capacity)), seed(seed),
+              cells(new Cell[capacity])
+        {
+        }
+
+        size_t home(uint64_t key) const
+        {
+            return ((key ^ seed) * 0x9E3779B97F4A7C15ull) >> shift;
+        }
+
+        // The cell holding key, or the empty cell where it would go;
+        // nullptr if the table is full
+        Cell* probe(uint64_t key) const
+        {
+            for (size_t i = home(key), n = 0; n < capacity; i = (i + 1) & mask, ++n)
+            {
+                const uint64_t k = cells[i].key.load(std::memory_order_acquire);
+                if (k == key || k == kEmptyKey)
+                {
+                    return &cells[i];
+                }
+            }
+            return nullptr;
+        }
+
+        const size_t capacity;
+        const size_t mask;
+        const int shift;
+        const uint64_t seed;    // differs per table, so that a rehash at the same size reshuffles clusters
+        std::unique_ptr<Cell[]> cells;
+
+        std::atomic<Table*> next{nullptr};
+        alignas(64) std::atomic<size_t> next_chunk{0};
+        alignas(64) std::atomic<size_t> chunks_done{0};
+    };
+
+    static void check_key(uint64_t key)
+    {
+        if (key == kEmptyKey) [[unlikely]]
+        {
+            throw std::invalid_argument("ConcurrentHashMap: key 0 is reserved");
+        }
+    }
+
+    static void check_value(uint64_t value)
+    {
+        if (value > kMaxValue) [[unlikely]]
+        {
+            throw std::invalid_argument("ConcurrentHashMap: value above kMaxValue");
+        }
+    }
+
+    static bool is_value(uint64_t value)
+    {
+        return value <= kMaxValue;
+    }
+
+    enum class Outcome
+    {
+        Done,
+        Failed,     // nothing changed, e.g. insert of a present key
+        Retry,      // the table is being migrated, or must be
+    };
+
+    bool update(uint64_t key, uint64_t value, Mode mode)
+    {
+        EpochDomain::Guard guard = domain_.pin();
+        while (true)
+        {
+            Table* table = table_.load(std::memory_order_acquire);
+            const Outcome outcome = update(*table, key, value, mode);
+            if (outcome != Outcome::Retry)
+            {
+                return outcome == Outcome::Done;
+            }
+            resize(table);
+        }
+    }
+
+    static Outcome update(Table& table, uint64_t key, uint64_t value, Mode mode)
+    {
+        for (size_t i = table.home(key), n = 0; n < table.capacity; i = (i + 1) & table.mask, ++n)
+        {
+            Cell& cell = table.cells[i];
+            uint64_t k = cell.key.load(std::memory_order_acquire);
+            if (k == kEmptyKey)
+            {
+                if (mode == Mode::Erase)
+                {
+                    // Absent, unless the migration already passed here
+                    return cell.value.load(std::memory_order_acquire) == kUnset ? Outcome::Failed : Outcome::Retry;
+                }
+                if (n >= kProbeLimit || cell.value.load(std::memory_order_acquire) != kUnset)
+                {
+                    return Outcome::Retry;
+                }
+                if (!cell.key.compare_exchange_strong(k, key, std::memory_order_acq_rel, std::memory_order_acquire) && k != key)
+                {
+                    continue;
+                }
+            }
+            else if (k != key)
+            {
+                continue;
+            }
+
+            return update(cell, value, mode);
+        }
+        return Outcome::Retry;
+    }
+
+    static Outcome update(Cell& cell, uint64_t value, Mode mode)
+    {
+        uint64_t current = cell.value.load(std::memory_order_acquire);
+        while (true)
+        {
+            if (current == kMoved || (current & kFrozen))
+            {
+                return Outcome::Retry;
+            }
+            if ((mode == Mode::InsertIfAbsent && is_value(current)) || (mode == Mode::Erase && !is_value(current)))
+            {
+                return Outcome::Failed;
+            }
+            if (cell.value.compare_exchange_weak(current, value, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                return Outcome::Done;
+            }
+        }
+    }
+
+    // Starts a new table unless a migration is on already, and helps
+    // finish the migration
+    void resize(Table* table)
+    {
+        if (table != table_.load(std::memory_order_acquire))
+        {
+            return;     // promoted meanwhile: retry in the new table
+        }
+
+        if (table->next.load(std::memory_order_acquire) == nullptr)
+        {
+            size_t live = 0;
+            for (size_t i = 0; i < table->capacity; ++i)
+            {
+                live += is_value(table->cells[i].value.load(std::memory_order_relaxed) & ~kFrozen);
+            }
+
+            Table* fresh = new Table(std::max(table->capacity, std::bit_ceil(4 * live)), table->seed + 0xD6E8FEB86659FD93ull);
+            Table* expected = nullptr;
+            if (!table->next.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel))
+            {
+                delete fresh;
+            }
+        }
+        migrate(*table);
+    }
+
+    void migrate(Table& table)
+    {
+        Table& next = *table.next.load(std::memory_order_acquire);
+        const size_t chunks = (table.capacity + kMigrationChunk - 1) / kMigrationChunk;
+
+        for (size_t chunk; (chunk = table.next_chunk.fetch_add(1, std::memory_order_relaxed)) < chunks;)
+        {
+            const size_t end = std::min(table.capacity, (chunk + 1) * kMigrationChunk);
+            for (size_t i = chunk * kMigrationChunk; i < end; ++i)
+            {
+                migrate(table.cells[i], next);
+            }
+            table.chunks_done.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        Backoff backoff;
+        while (table.chunks_done.load(std::memory_order_acquire) < chunks)
+        {
+            backoff.pause();
+        }
+
+        Table* expected = &table;
+        if (table_.compare_exchange_strong(expected, &next, std::memory_order_acq_rel))
+        {
+            domain_.retire(&table);
+        }
+    }
+
+    // Chunk owner only
+    static void migrate(Cell& cell, Table& next)
+    {
+        const uint64_t value = cell.value.fetch_or(kFrozen, std::memory_order_acq_rel);
+        const uint64_t key = cell.key.load(std::memory_order_acquire);
+        if (key != kEmptyKey && is_value(value))
+        {
+            copy(next, key, value);
+        }
+        cell.value.store(kMoved, std::memory_order_release);
+    }
+
+    // The next table is not migrated before this one is done, so the copy
+    // never has to follow a chain; it ignores kProbeLimit
+    static void copy(Table& table, uint64_t key, uint64_t value)
+    {
+        Cell* cell = table.probe(key);
+        if (cell == nullptr)
+        {
+            throw std::length_error("ConcurrentHashMap: table full during resize");
+        }
+
+        uint64_t k = kEmptyKey;
+        cell->key.compare_exchange_strong(k, key, std::memory_order_acq_rel, std::memory_order_acquire);
+        if (k != kEmptyKey && k != key)
+        {
+            return copy(table, key, value);     // lost the cell to another key
+        }
+
+        uint64_t unset = kUnset;
+        cell->value.compare_exchange_strong(unset, value, std::memory_order_acq_rel, std::memory_order_relaxed);
+    }
+
+    EpochDomain& domain_;
+    alignas(64) std::atomic<Table*> table_;
+};
@@ -0,0 +1,112 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "free_list.h"
+#include "shared_fixture.h"
+#include "spin_lock.h"
+
+// Note
+/*
+    Threads share one object pool, as the producers of a shared ring
+    would: each takes a few objects, touches them, and gives them back.
+
+    -   SpinLockPool: the free list is a std::vector of indices behind the
+        project's SpinLock. Every acquire and release takes the lock, so
+        the threads queue up on it, and a thread preempted while holding
+        it stalls everybody.
+    -   ConcurrentObjectPool: the free list is a TaggedIndexStack, one
+        compare-exchange per acquire and release; a preempted thread
+        blocks nobody.
+
+    On one thread the SpinLock pool is as fast or faster: its lock is an
+    exchange and a plain store, while each compare-exchange here waits for
+    the one before it. The lock-free pool pays off once threads contend
+    or get preempted.
+*/
+constexpr size_t kPoolCapacity = 4096;
+constexpr size_t kObjectsPerRound = 4;
+
+struct Order
+{
+    uint64_t id;
+    uint32_t price;
+    uint32_t shares;
+};
+
+template <typename T, size_t Capacity>
+class SpinLockPool
+{
+public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    SpinLockPool() : objects_(Capacity)
+    {
+        free_.reserve(Capacity);
+        for (size_t i = Capacity; i-- > 0;)
+        {
+            free_.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    uint32_t acquire()
+    {
+        std::lock_guard<SpinLock> guard(lock_);
+        if (free_.empty())
+        {
+            return kNone;
+        }
+        const uint32_t index = free_.back();
+        free_.pop_back();
+        return index;
+    }
+
+    void release(uint32_t index)
+    {
+        std::lock_guard<SpinLock> guard(lock_);
+        free_.push_back(index);
+    }
+
+    T& get(uint32_t index)
+    {
+        return objects_[index];
+    }
+
+private:
+    SpinLock lock_;
+    std::vector<uint32_t> free_;
+    std::vector<T> objects_;
+};
+
+template <typename Pool>
+void acquire_release(benchmark::State& state, Pool& pool)
+{
+    std::array<uint32_t, kObjectsPerRound> held;
+    uint64_t id = 0;
+
+    for (auto _ : state)
+    {
+        for (uint32_t& index : held)
+        {
+            index = pool.acquire();
+            Order& order = pool.get(index);
+            order.id = ++id;
+            order.shares = 100;
+        }
+        for (uint32_t index : held)
+        {
+            benchmark::DoNotOptimize(pool.get(index).id);
+            pool.release(index);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * kObjectsPerRound);
+}
+
+SHARED_BENCHMARK(SpinLockPool, acquire_release, SpinLockPool<Order, kPoolCapacity>)->ThreadRange(1, 16);
+
+SHARED_BENCHMARK(ConcurrentObjectPool, acquire_release, ConcurrentObjectPool<Order, kPoolCapacity>)->ThreadRange(1, 16);
+
+BENCHMARK_MAIN();
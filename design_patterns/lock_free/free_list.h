@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+#include "spin_lock.h"
+
+// Lock-free intrusive stack of indices (Treiber stack), ABA-safe
+/*
+    -   The ABA problem: pop() reads head A and its next B, and is
+        preempted. Meanwhile A is popped, B is popped, A is pushed back.
+        pop() resumes, its compare-exchange sees A at the head and succeeds,
+        and installs B, which is no longer on the stack.
+
+    -   Fix: the head is one 64 bit word, a 32 bit index into a fixed array
+        of nodes and a 32 bit tag that every successful push and pop
+        increments. The compare-exchange then fails unless nothing at all
+        happened in between. A plain 64 bit CAS suffices; no 128 bit
+        cmpxchg16b, which needs -mcx16 and is not lock-free everywhere.
+
+    -   Nodes are never freed, only pushed back, so reading the next link
+        of a node another thread has just popped is safe: the value may be
+        stale, but then the tag has changed and the exchange fails. The
+        link is a relaxed atomic so that the racing read is not a data race.
+
+    -   The tag wraps after 2^32 operations: a thread would have to stall
+        between its load and its exchange for exactly that many to be
+        fooled.
+
+    Node is any type with a std::atomic<uint32_t> next member; the stack
+    links the nodes of the array it is given through it.
+*/
+template <typename Node>
+class TaggedIndexStack
+{
+public:
+    static constexpr uint32_t kEmpty = std::numeric_limits<uint32_t>::max();
+
+    explicit TaggedIndexStack(Node* nodes) : nodes_(nodes) {}
+
+    void push(uint32_t index)
+    {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t desired;
+        do
+        {
+            nodes_[index].next.store(index_of(head), std::memory_order_relaxed);
+            desired = pack(tag_of(head) + 1, index);
+        } while (!head_.compare_exchange_weak(head, desired, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // kEmpty if the stack is empty
+    uint32_t pop()
+    {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        while (true)
+        {
+            const uint32_t index = index_of(head);
+            if (index == kEmpty)
+            {
+                return kEmpty;
+            }
+
+            const uint32_t next = nodes_[index].next.load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, pack(tag_of(head) + 1, next), std::memory_order_acquire, std::memory_order_acquire))
+            {
+                return index;
+            }
+        }
+    }
+
+    bool empty() const
+    {
+        return index_of(head_.load(std::memory_order_relaxed)) == kEmpty;
+    }
+
+private:
+    static uint64_t pack(uint32_t tag, uint32_t index)
+    {
+        return static_cast<uint64_t>(tag) << 32 | index;
+    }
+
+    static uint32_t tag_of(uint64_t head)
+    {
+        return static_cast<uint32_t>(head >> 32);
+    }
+
+    static uint32_t index_of(uint64_t head)
+    {
+        return static_cast<uint32_t>(head);
+    }
+
+    Node* nodes_;
+    alignas(kLockCacheLineSize) std::atomic<uint64_t> head_{pack(0, kEmpty)};
+};
+
+// Fixed capacity object pool any thread can acquire from and release to
+/*
+    Objects are addressed by index and live in cache line aligned slots,
+    so objects held by different threads never share a line. The free
+    list is a TaggedIndexStack through the slots: acquire and release
+    are one compare-exchange each when uncontended, and never allocate.
+    LIFO order hands back the slot released last, the one most likely
+    still in cache.
+*/
+template <typename T, size_t Capacity>
+class ConcurrentObjectPool
+{
+    static_assert(Capacity < TaggedIndexStack<int>::kEmpty, "indices are 32 bit");
+
+public:
+    static constexpr uint32_t kNone = TaggedIndexStack<int>::kEmpty;
+
+    ConcurrentObjectPool() : free_(slots_.data())
+    {
+        for (size_t i = Capacity; i-- > 0;)
+        {
+            free_.push(static_cast<uint32_t>(i));
+        }
+    }
+
+    ConcurrentObjectPool(const ConcurrentObjectPool&) = delete;
+    ConcurrentObjectPool& operator=(const ConcurrentObjectPool&) = delete;
+
+    // kNone when every object is taken
+    uint32_t acquire()
+    {
+        return free_.pop();
+    }
+
+    void release(uint32_t index)
+    {
+        free_.push(index);
+    }
+
+    T& get(uint32_t index)
+    {
+        return slots_[index].value;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+private:
+    struct alignas(kLockCacheLineSize) Slot
+    {
+        T value{};
+        std::atomic<uint32_t> next{0};
+    };
+
+    std::array<Slot, Capacity> slots_;
+    TaggedIndexStack<Slot> free_;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "spin_lock.h"
+
+// Spin-then-park mutex on a futex (Drepper, "Futexes Are Tricky", mutex 3)
+/*
+    -   Three states: 0 unlocked, 1 locked, 2 locked and somebody may be
+        asleep. unlock() only makes a system call in state 2; an uncontended
+        lock/unlock pair is two atomic instructions and no syscall.
+
+    -   A contended lock() first spins, hoping the holder is about to
+        release, since a short hold is over long before a sleep and wake up
+        would be. Only then does it mark the lock 2 and sleep in the kernel.
+        std::mutex gives up almost at once; SpinLock never sleeps and burns
+        the core of whoever it is waiting for when there are more threads
+        than cores.
+
+    -   How long to spin adapts to the lock: every acquisition that had to
+        spin moves the spin limit towards twice the spins it took (as
+        glibc's adaptive mutex does), and every spin that ran out without
+        the lock pulls the limit down. Locks held briefly end up spinning
+        just long enough, locks held for long end up parking almost at once.
+
+    -   The raw futex rather than std::atomic::wait/notify: those spin on
+        their own and keep a waiter count of their own, but the state
+        already says whether anybody sleeps.
+*/
+class FutexMutex
+{
+public:
+    static constexpr uint32_t kMinSpins = 16;
+    static constexpr uint32_t kMaxSpins = 2048;
+
+    void lock()
+    {
+        uint32_t state = kUnlocked;
+        if (state_.compare_exchange_strong(state, kLocked, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        if (spin())
+        {
+            return;
+        }
+
+        // Park. Whoever takes the lock from here on takes it in state 2,
+        // since it cannot know whether other sleepers are left
+        if (state != kContended)
+        {
+            state = state_.exchange(kContended, std::memory_order_acquire);
+        }
+        while (state != kUnlocked)
+        {
+            futex(FUTEX_WAIT_PRIVATE, kContended);
+            state = state_.exchange(kContended, std::memory_order_acquire);
+        }
+    }
+
+    bool try_lock()
+    {
+        uint32_t state = kUnlocked;
+        return state_.compare_exchange_strong(state, kLocked, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock()
+    {
+        if (state_.fetch_sub(1, std::memory_order_release) != kLocked)
+        {
+            state_.store(kUnlocked, std::memory_order_release);
+            futex(FUTEX_WAKE_PRIVATE, 1);
+        }
+    }
+
+    // The current spin limit
+    uint32_t spin_limit() const
+    {
+        return std::clamp(2 * average_spins_.load(std::memory_order_relaxed), kMinSpins, kMaxSpins);
+    }
+
+private:
+    static constexpr uint32_t kUnlocked = 0;
+    static constexpr uint32_t kLocked = 1;
+    static constexpr uint32_t kContended = 2;
+
+    // Returns whether the lock was taken while spinning
+    bool spin()
+    {
+        const uint32_t limit = spin_limit();
+        const uint32_t average = average_spins_.load(std::memory_order_relaxed);
+
+        for (uint32_t spins = 0; spins < limit; ++spins)
+        {
+            cpu_relax();
+            uint32_t state = state_.load(std::memory_order_relaxed);
+            if (state == kUnlocked &&
+                state_.compare_exchange_weak(state, kLocked, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                // Racy read-modify-write on purpose: it is only a hint
+                average_spins_.store(average + (static_cast<int32_t>(spins - average) / 8), std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        average_spins_.store(average - average / 8, std::memory_order_relaxed);
+        return false;
+    }
+
+    long futex(int op, uint32_t value)
+    {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state_), op, value, nullptr, nullptr, 0);
+    }
+
+    std::atomic<uint32_t> state_{kUnlocked};
+    std::atomic<uint32_t> average_spins_{kMinSpins};
+};
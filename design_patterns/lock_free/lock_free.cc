@@ -1,11 +1,17 @@
 #include <benchmark/benchmark.h>
 #include <vector>
+#include <algorithm>
 #include <random>
 #include <mutex>
 #include <shared_mutex>
 #include <atomic>
 #include <iostream>
 #include <thread>
+#include <chrono>
+#include <cstdint>
+
+#include "futex_mutex.h"
+#include "spin_lock.h"
 
 // Note
 /*
@@ -14,7 +20,21 @@
     LockFree > SpinLock > Mutex > Shared_Mutex
 
     Please keep in mind that in our benchmark, the critical section has only 
-    one operation but in real scenarios it has more.
+    one operation but in real scenarios it has more. The lock benchmarks
+    therefore take the critical section's length as their argument: that
+    many dependent multiply-adds on the protected counter.
+
+    -   Short sections: SpinLock wins, the waiters barely spin before the
+        lock is free again. TicketLock and MCSLock pay for fairness with a
+        hand-off to one particular waiter, which may not be running.
+    -   Long sections with many threads: SpinLock's waiters stampede on
+        every release; MCSLock's waiters each spin on their own line.
+    -   FutexMutex spins about as long as the lock is usually held, then
+        sleeps: close to SpinLock when sections are short, and it stops
+        burning cores (and the tail) once they are long.
+
+    Throughput hides unfairness, so the lock benchmarks also report
+    percentiles of how long lock() took, in ns, averaged over the threads.
 */
 
 template <typename LockType>
@@ -43,7 +63,7 @@ public:
 
 protected:
     // std::atomic<int> counter;
-    int counter;
+    uint32_t counter;  // unsigned: critical_section() wraps it
     LockType lock; // Templated lock object
 };
 
@@ -80,196 +100,98 @@ BENCHMARK_DEFINE_F(LockFreeBenchmark, LockFreeTest)(benchmark::State& state) {
     state.SetItemsProcessed(state.iterations());
 }
 
-// Analysis
-/*
-    -   Why this SpinLock is so efficient under high contention:
-
-        1. Reduces expensive exchange operations
-
-            lock_.exchange() is a Read-Modify-Write (RMW) operation that requires
-            cache coherence synchronization (MESI protocol) between CPUs, which 
-            is very expensive.
-            
-            The exchange operation is only performed when the lock is likely to 
-            be released (after internal load sees false), significantly reducing 
-            RMW operations.
-
-        2. Better cache friendliness
-
-            -   load() is a pure read operation, much cheaper than exchange
-            -   Multiple threads can simultaneously read the lock state without 
-                generating cache coherence traffic
-            -   When the lock is released, all waiting threads can observe the 
-                change almost simultaneously
-
-        3. Reduces bus contention
+// The protected work: length dependent steps, so it cannot be vectorised
+// or folded away. Unsigned, so the multiply wraps instead of overflowing.
+inline void critical_section(uint32_t& counter, int64_t length)
+{
+    for (int64_t i = 0; i < length; ++i)
+    {
+        counter = counter * 1103515245 + 12345;
+    }
+    benchmark::DoNotOptimize(counter);
+}
 
-            -   Frequent exchange operations can saturate the memory bus and 
-                cache coherence protocol
-            -   Implementation two allows waiting threads to spin "quietly", 
-                only participating in intense lock competition when necessary
+// Threads 1, 2, 4 ... 16. A FIFO lock hands the lock to one particular
+// waiter; with more threads than cores that waiter is often not running, so
+// every hand-off waits for the scheduler. TicketLock and MCSLock only run
+// with up to as many threads as there are cores.
+constexpr int kMaxLockThreads = 16;
+const int kMaxFifoLockThreads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, kMaxLockThreads);
 
-    -   Correctness of memory ordering
+// Every kLatencySampleEvery-th lock() is timed, so reading the clock barely
+// moves the throughput; the last kLatencySamples samples are kept
+constexpr int64_t kLatencySampleEvery = 16;
+constexpr size_t kLatencySamples = 1 << 16;
 
-        The memory ordering usage in both implementations is correct:
+void report_latency_percentiles(benchmark::State& state, std::vector<int64_t>& samples)
+{
+    if (samples.empty())
+    {
+        return;
+    }
 
-        -   exchange(..., std::memory_order_acquire): Establishes acquire semantics when acquiring the lock,
-            ensuring critical section operations are not reordered before it
+    for (const auto& [name, percentile] : {std::pair{"p50_ns", 0.5}, {"p99_ns", 0.99}, {"p999_ns", 0.999}})
+    {
+        auto nth = samples.begin() + static_cast<size_t>(percentile * (samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        state.counters[name] = benchmark::Counter(*nth, benchmark::Counter::kAvgThreads);
+    }
+}
 
-        -   load(std::memory_order_relaxed): During spin waiting, only atomicity is needed, not synchronization semantics,
-            so relaxed is sufficient and lightest weight
-    
-*/
-struct SpinLock {
-    std::atomic<bool> lock_ = {false};
+template <typename Lock>
+void lock_and_work(benchmark::State& state, Lock& lock, uint32_t& counter)
+{
+    const int64_t length = state.range(0);
+    std::vector<int64_t> samples;
+    samples.reserve(kLatencySamples);
+    int64_t iteration = 0;
 
-    void lock() 
+    for (auto _ : state)
     {
-        // The first implementation
-        /*
-        for (;;) 
-        {
-            if (!lock_.exchange(true, std::memory_order_acquire)) 
-            {
-                break; // Successfully acquired the lock, breaking out
-            }
-            while (lock_.load(std::memory_order_relaxed));
-            // {
-            //     // Optional: Reduce CPU usage
-            //     #ifdef __x86_64__
-            //     __builtin_ia32_pause();
-            //     #elif defined(__aarch64__)
-            //     asm volatile("yield" ::: "memory");
-            //     #else
-            //     std::this_thread::yield();
-            //     #endif
-            // }
-        }
-        */
-
-        // The second implementation performs almost equivalently to the first one.
-        /*
-        while(lock_.exchange(true, std::memory_order_acquire))
+        if (++iteration % kLatencySampleEvery != 0)
         {
-            while(lock_.load(std::memory_order_relaxed)); //spin
-        }
-        */
-
-        // The third implementation
-        // Step 1: Fast path, assuming the lock is free(false)
-        // and if exchange the lock to from false to true successfully, return 
-        // immediately. This operation is the same as try_lock()
-        if (!lock_.load(std::memory_order_relaxed) && 
-            !lock_.exchange(true, std::memory_order_acquire)) {
-            return; // Quick acquisition successful
+            lock.lock();
         }
-
-        while (true)
+        else
         {
-            // First, wait for the lock to potentially release
-            while (lock_.load(std::memory_order_relaxed)) {
-                // Optionally add CPU pause instruction or thread yield
-                // __builtin_ia32_pause(); // x86 pause instruction
-                // std::this_thread::yield(); // Yield timeslice
+            const auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            if (samples.size() < kLatencySamples)
+            {
+                samples.push_back(ns);
             }
-
-            // Try to acquire again
-            // Why using exchange() is ok here?
-            // -    exchange() is an atomic operation which means no one could 
-            //      interrupt in between. 
-            // -    If successfully change lock_'s value from false to true, 
-            //      !lock.exchange() returns the lock_'s previous value, which 
-            //      is false thus breaking out of the loop.
-            //  -   ABA problem could happen here. As long as lock_exchange() returns 
-            //      false, everything is fine.
-            if (!lock_.exchange(true, std::memory_order_acquire)) {
-                break;
+            else
+            {
+                samples[(iteration / kLatencySampleEvery) % kLatencySamples] = ns;
             }
         }
-        
-        // The fourth implementation (from M$ chatbot)
-        /*
-        while (flag.test_and_set(std::memory_order_acquire)) {
-            std::atomic_signal_fence(std::memory_order_acquire);   
-        }*/
-    }
-
-    // the fourth implementation
-    //alignas(64) std::atomic_flag flag = ATOMIC_FLAG_INIT;
-
-
-    void unlock() 
-    { 
-        // !! guarantee the critical section codes are not reordered after it
-        lock_.store(false, std::memory_order_release);
-
-        // the fouth implementation
-        //flag.clear(std::memory_order_release);
-    }
-
-    /*
-        The try_lock() should first check if the lock is free before 
-        attempting to acquire it. This would prevent excessive coherency 
-        traffic in case someone loops over try_lock().
-    */
-    bool try_lock() noexcept
-    {
-        // First do a relaxed load to check if lock is free in order 
-        // to prevent unnecessary cache misses if someone does while (!try_lock())
-        return !lock_.load(std::memory_order_relaxed) && 
-               !lock_.exchange(true, std::memory_order_acquire);
-    }
-};
-
-// Define templated benchmarks
-BENCHMARK_TEMPLATE_DEFINE_F(LockBenchmark, MutexTest, std::mutex)(benchmark::State& state) {
-    for (auto _ : state) {
-        lock.lock();
-        // counter.fetch_add(1, std::memory_order_relaxed);
-        counter++;
-        lock.unlock();
-    }
-    state.SetItemsProcessed(state.iterations());
-}
-
-BENCHMARK_TEMPLATE_DEFINE_F(LockBenchmark, SharedMutexTest, std::shared_mutex)(benchmark::State& state) {
-    for (auto _ : state) {
-        lock.lock();
-        // counter.fetch_add(1, std::memory_order_relaxed);
-        counter++;
+        critical_section(counter, length);
         lock.unlock();
     }
-    state.SetItemsProcessed(state.iterations());
-}
 
-BENCHMARK_TEMPLATE_DEFINE_F(LockBenchmark, SpinLockTest, SpinLock)(benchmark::State& state) {
-    for (auto _ : state) {
-        lock.lock();
-        // counter.fetch_add(1, std::memory_order_relaxed);
-        counter++;
-        lock.unlock();
-    }
     state.SetItemsProcessed(state.iterations());
+    report_latency_percentiles(state, samples);
 }
 
-BENCHMARK_REGISTER_F(LockBenchmark, MutexTest)->Name("Mutex")
-    ->Threads(1)  // Test with 1 thread
-    ->Threads(2)  // Test with 2 threads
-    ->Threads(4); // Test with 4 threads
-
-BENCHMARK_REGISTER_F(LockBenchmark, SharedMutexTest)->Name("SharedMutex")
-    ->Threads(1)  // Test with 1 thread
-    ->Threads(2)  // Test with 2 threads
-    ->Threads(4);  // Test with 4 threads
+#define LOCK_BENCHMARK(Test, Lock, MaxThreads)                                             \
+    BENCHMARK_TEMPLATE_DEFINE_F(LockBenchmark, Test, Lock)(benchmark::State & state)        \
+    {                                                                                      \
+        lock_and_work(state, lock, counter);                                               \
+    }                                                                                      \
+    BENCHMARK_REGISTER_F(LockBenchmark, Test)->Name(#Lock)                                 \
+        ->ArgName("cs")->Arg(1)->Arg(16)->Arg(256)                                         \
+        ->ThreadRange(1, MaxThreads)->UseRealTime()
 
-BENCHMARK_REGISTER_F(LockBenchmark, SpinLockTest)->Name("SpinLock")
-    ->Threads(1)  // Test with 1 thread
-    ->Threads(2)  // Test with 2 threads
-    ->Threads(4); // Test with 4 threads
+// Define templated benchmarks
+LOCK_BENCHMARK(MutexTest, std::mutex, kMaxLockThreads);
+LOCK_BENCHMARK(SharedMutexTest, std::shared_mutex, kMaxLockThreads);
+LOCK_BENCHMARK(SpinLockTest, SpinLock, kMaxLockThreads);
+LOCK_BENCHMARK(FutexMutexTest, FutexMutex, kMaxLockThreads);
+LOCK_BENCHMARK(TicketLockTest, TicketLock, kMaxFifoLockThreads);
+LOCK_BENCHMARK(MCSLockTest, MCSLock, kMaxFifoLockThreads);
 
 BENCHMARK_REGISTER_F(LockFreeBenchmark, LockFreeTest)->Name("LockFreeTest")
-    ->Threads(1)  // Test with 1 thread
-    ->Threads(2)  // Test with 2 threads
-    ->Threads(4);  // Test with 4 threads
+    ->ThreadRange(1, kMaxLockThreads)->UseRealTime();
 
 BENCHMARK_MAIN();
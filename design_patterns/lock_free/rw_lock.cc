@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+
+#include "rw_lock.h"
+#include "shared_fixture.h"
+#include "spin_lock.h"
+
+// Note
+/*
+    A read-mostly table: each operation reads one entry under a shared lock,
+    or, for 5% or 1% of operations, updates one under an exclusive lock.
+
+    -   shared_mutex: readers never wait for each other, yet every read
+        still bounces the lock's reader count between the cores, so reads
+        stop scaling after a few threads.
+    -   SpinLock: every operation is exclusive, the baseline.
+    -   DistributedRWLock: a read writes only the reader's own slot, so
+        reads scale with the cores. The writes are more expensive, which
+        is why it pays off at 99/1 more than at 95/5.
+*/
+constexpr size_t kTableSize = 256;
+
+// lock_shared() is lock(): the exclusive baseline
+template <typename Lock>
+struct ExclusiveOnly : Lock
+{
+    void lock_shared()
+    {
+        this->lock();
+    }
+
+    void unlock_shared()
+    {
+        this->unlock();
+    }
+};
+
+// The lock and the table it guards
+template <typename Lock>
+struct LockedTable
+{
+    Lock lock;
+    std::array<uint64_t, kTableSize> table{};
+};
+
+// state.range(0): percentage of operations that are reads
+template <typename Lock>
+void read_mostly(benchmark::State& state, LockedTable<Lock>& locked)
+{
+    Lock& lock = locked.lock;
+    std::array<uint64_t, kTableSize>& table = locked.table;
+    const uint64_t read_percent = state.range(0);
+    uint64_t random = 0x9E3779B97F4A7C15ull * (state.thread_index() + 1);
+    uint64_t sum = 0;
+
+    for (auto _ : state)
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        const size_t key = random % kTableSize;
+
+        if ((random >> 32) % 100 < read_percent)
+        {
+            std::shared_lock guard(lock);
+            sum += table[key];
+        }
+        else
+        {
+            std::lock_guard guard(lock);
+            ++table[key];
+        }
+    }
+
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations());
+}
+
+SHARED_BENCHMARK(SharedMutex, read_mostly, LockedTable<std::shared_mutex>)
+    ->ArgName("reads%")->Arg(95)->Arg(99)->ThreadRange(1, 16);
+
+SHARED_BENCHMARK(SpinLock, read_mostly, LockedTable<ExclusiveOnly<SpinLock>>)
+    ->ArgName("reads%")->Arg(95)->Arg(99)->ThreadRange(1, 16);
+
+SHARED_BENCHMARK(DistributedRWLock, read_mostly, LockedTable<DistributedRWLock>)
+    ->ArgName("reads%")->Arg(95)->Arg(99)->ThreadRange(1, 16);
+
+BENCHMARK_MAIN();
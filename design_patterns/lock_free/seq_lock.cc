@@ -0,0 +1,130 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+
+#include "seq_lock.h"
+#include "shared_fixture.h"
+#include "spin_lock.h"
+
+// Note
+/*
+    One writer updates a quote as fast as it can while 1, 2, 4 or 8 readers
+    read it, i.e. the worst case for the readers of every lock.
+
+    -   shared_mutex: every read takes and releases the lock, two atomic
+        read-modify-writes on a counter all the readers share. The line
+        bounces between the readers' cores even when nobody writes.
+    -   SpinLock: readers exclude each other as well as the writer.
+    -   SeqLock: readers only load. They retry when they overlap a store,
+        which the retries counter shows.
+
+    The writer keeps ask = bid + 1; a reader that sees anything else has
+    read a torn quote, which the torn counter would show. It stays 0.
+*/
+struct Quote
+{
+    uint32_t bid_price;
+    uint32_t bid_shares;
+    uint32_t ask_price;
+    uint32_t ask_shares;
+    uint64_t timestamp_ns;
+};
+
+Quote next_quote(const Quote& quote)
+{
+    Quote next = quote;
+    ++next.bid_price;
+    next.ask_price = next.bid_price + 1;
+    next.bid_shares = next.ask_shares = next.bid_price % 1000;
+    ++next.timestamp_ns;
+    return next;
+}
+
+class SharedMutexQuote
+{
+public:
+    void store(const Quote& quote)
+    {
+        std::unique_lock lock(mutex_);
+        quote_ = quote;
+    }
+
+    bool try_load(Quote& quote) const
+    {
+        std::shared_lock lock(mutex_);
+        quote = quote_;
+        return true;
+    }
+
+private:
+    mutable std::shared_mutex mutex_;
+    Quote quote_{};
+};
+
+class SpinLockQuote
+{
+public:
+    void store(const Quote& quote)
+    {
+        std::lock_guard lock(lock_);
+        quote_ = quote;
+    }
+
+    bool try_load(Quote& quote) const
+    {
+        std::lock_guard lock(lock_);
+        quote = quote_;
+        return true;
+    }
+
+private:
+    mutable SpinLock lock_;
+    Quote quote_{};
+};
+
+template <typename GuardedQuote>
+void read_write_quote(benchmark::State& state, GuardedQuote& guarded)
+{
+    int64_t reads = 0;
+    int64_t writes = 0;
+    int64_t retries = 0;
+    int64_t torn = 0;
+    Quote quote{};
+
+    for (auto _ : state)
+    {
+        if (state.thread_index() == 0)
+        {
+            quote = next_quote(quote);
+            guarded.store(quote);
+            ++writes;
+        }
+        else
+        {
+            while (!guarded.try_load(quote))
+            {
+                ++retries;
+            }
+            torn += quote.ask_price != quote.bid_price + 1 && quote.timestamp_ns != 0;
+            ++reads;
+        }
+    }
+
+    state.counters["reads"] = benchmark::Counter(reads, benchmark::Counter::kIsRate);
+    state.counters["writes"] = benchmark::Counter(writes, benchmark::Counter::kIsRate);
+    state.counters["retries"] = benchmark::Counter(retries);
+    state.counters["torn"] = benchmark::Counter(torn);
+}
+
+// Thread 0 writes, the others read: 1, 2, 4 and 8 readers
+SHARED_BENCHMARK(SharedMutex, read_write_quote, SharedMutexQuote)
+    ->Threads(2)->Threads(3)->Threads(5)->Threads(9);
+
+SHARED_BENCHMARK(SpinLock, read_write_quote, SpinLockQuote)
+    ->Threads(2)->Threads(3)->Threads(5)->Threads(9);
+
+SHARED_BENCHMARK(SeqLock, read_write_quote, SeqLock<Quote>)
+    ->Threads(2)->Threads(3)->Threads(5)->Threads(9);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "spin_lock.h"
+
+// Sequence lock: one writer, any number of readers that never write
+/*
+    -   The writer makes the version odd, writes the value and makes the
+        version even again. A reader reads the version, copies the value and
+        reads the version again: if it was odd or has changed, the copy may
+        be torn and the reader tries again.
+
+    -   Readers do not write to shared memory at all, so they do not take
+        the cache line from each other or from the writer the way a
+        shared_mutex's reader count does. A read costs two loads of the
+        version and the copy; reads scale with the number of cores.
+
+    -   The flip side: a writer that never pauses can starve readers, and
+        the value is copied on every read, so T should be small (a few cache
+        lines at most), e.g. a top of book.
+
+    -   Memory ordering, correct on weakly ordered CPUs (ARM) as well as x86
+        -   The value is stored as relaxed atomic words, so the racing copy
+            is not a data race, and the fences order it against the version.
+        -   Writer: version store, release fence, value stores. The fence
+            keeps the value stores from becoming visible before the odd
+            version. Then a release store of the even version.
+        -   Reader: acquire load of the version, value loads, acquire fence,
+            version load. The fence keeps the value loads from being
+            satisfied after the second version load.
+        On x86 both fences compile to nothing; only the compiler is held
+        back. On ARM they are a dmb.
+
+    store() is for a single writer; several writers must serialise their
+    stores themselves, e.g. with a SpinLock.
+*/
+template <typename T>
+class alignas(kLockCacheLineSize) SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock copies T byte by byte");
+
+public:
+    explicit SeqLock(const T& value = T{})
+    {
+        write_words(value);
+    }
+
+    void store(const T& value)
+    {
+        const uint64_t version = version_.load(std::memory_order_relaxed);
+        version_.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        write_words(value);
+
+        version_.store(version + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        T value;
+        while (!try_load(value))
+        {
+            cpu_relax();
+        }
+        return value;
+    }
+
+    // One attempt; false if a store was in progress
+    bool try_load(T& value) const
+    {
+        const uint64_t before = version_.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            return false;
+        }
+
+        std::array<uint64_t, kWords> copy;
+        for (size_t i = 0; i < kWords; ++i)
+        {
+            copy[i] = words_[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version_.load(std::memory_order_relaxed) != before)
+        {
+            return false;
+        }
+
+        std::memcpy(&value, copy.data(), sizeof(T));
+        return true;
+    }
+
+    // Number of completed stores
+    uint64_t version() const
+    {
+        return version_.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void write_words(const T& value)
+    {
+        std::array<uint64_t, kWords> copy{};
+        std::memcpy(copy.data(), &value, sizeof(T));
+        for (size_t i = 0; i < kWords; ++i)
+        {
+            words_[i].store(copy[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint64_t> version_{0};
+    std::array<std::atomic<uint64_t>, kWords> words_;
+};
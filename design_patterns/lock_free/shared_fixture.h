@@ -0,0 +1,62 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// Fixture for benchmarks whose threads all work on one shared T
+/*
+    -   Every run gets a fresh T, so that no run starts with what the one
+        before left behind: entries, a grown table, an advanced epoch or
+        retired nodes. Thread 0 builds it in SetUp().
+
+    -   The other threads wait in SetUp() until every thread has arrived:
+        google benchmark does not wait for all threads before starting the
+        timed loop, so without the barrier a thread could use the previous
+        run's T while thread 0 replaces it. Hand-rolled, as std::barrier is
+        not available everywhere (macOS).
+*/
+template <typename T>
+class SharedFixture : public benchmark::Fixture
+{
+public:
+    void SetUp(const benchmark::State& state) override
+    {
+        const uint64_t phase = phase_.load(std::memory_order_acquire);
+        if (state.thread_index() == 0)
+        {
+            shared = std::make_unique<T>();
+        }
+
+        if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == state.threads())
+        {
+            arrived_.store(0, std::memory_order_relaxed);
+            phase_.store(phase + 1, std::memory_order_release);
+        }
+        else
+        {
+            while (phase_.load(std::memory_order_acquire) == phase)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+protected:
+    std::unique_ptr<T> shared;
+
+private:
+    std::atomic<int> arrived_{0};
+    std::atomic<uint64_t> phase_{0};
+};
+
+// Registers Function(state, T&) on a SharedFixture<T> as benchmark Label;
+// chain thread counts and arguments onto it
+#define SHARED_BENCHMARK(Label, Function, ...)                                                 \
+    BENCHMARK_TEMPLATE_DEFINE_F(SharedFixture, Label, __VA_ARGS__)(benchmark::State & state)   \
+    {                                                                                          \
+        Function(state, *shared);                                                              \
+    }                                                                                          \
+    BENCHMARK_REGISTER_F(SharedFixture, Label)->Name(#Label)->UseRealTime()
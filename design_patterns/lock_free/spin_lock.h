@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Spin locks
+/*
+    -   SpinLock: test-and-test-and-set with bounded exponential backoff.
+        Cheapest when uncontended, but unfair: whoever sees the release
+        first wins, and a waiter can starve.
+
+    -   TicketLock: FIFO. Waiters take a ticket and spin until it is served.
+        Fair, but every waiter still spins on the same cache line, so each
+        release invalidates all of them.
+
+    -   MCSLock: FIFO queue lock. Each waiter spins on its own node, on its
+        own cache line, and a release touches only the next waiter's line.
+        Coherence traffic per hand-off is constant however many wait.
+
+    All three are BasicLockable (lock/unlock; SpinLock and TicketLock also
+    try_lock) and work with std::lock_guard. Waiters spin with a pause
+    instruction and yield once they have spun for long, so they do not
+    burn the holder's time slice when there are more threads than cores.
+*/
+constexpr size_t kLockCacheLineSize = 64;
+
+// One step of a spin-wait loop: tells the core we are spinning, so it
+// saves power and does not mis-speculate a memory order violation on exit
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Exponential backoff: 1, 2, 4 ... kMaxPauses pauses per step, then a
+// yield per step once kYieldAfter steps have been taken
+class Backoff
+{
+public:
+    static constexpr uint32_t kMaxPauses = 256;
+    static constexpr uint32_t kYieldAfter = 16;
+
+    void pause()
+    {
+        if (steps_++ >= kYieldAfter)
+        {
+            std::this_thread::yield();
+            return;
+        }
+        for (uint32_t i = 0; i < pauses_; ++i)
+        {
+            cpu_relax();
+        }
+        pauses_ = std::min(pauses_ * 2, kMaxPauses);
+    }
+
+private:
+    uint32_t pauses_ = 1;
+    uint32_t steps_ = 0;
+};
+
+// Analysis
+/*
+    -   Why test-and-test-and-set is so efficient under high contention:
+
+        1. Reduces expensive exchange operations
+
+            lock_.exchange() is a Read-Modify-Write (RMW) operation that requires
+            cache coherence synchronization (MESI protocol) between CPUs, which
+            is very expensive.
+
+            The exchange operation is only performed when the lock is likely to
+            be released (after internal load sees false), significantly reducing
+            RMW operations.
+
+        2. Better cache friendliness
+
+            -   load() is a pure read operation, much cheaper than exchange
+            -   Multiple threads can simultaneously read the lock state without
+                generating cache coherence traffic
+            -   When the lock is released, all waiting threads can observe the
+                change almost simultaneously
+
+        3. Reduces bus contention
+
+            -   Frequent exchange operations can saturate the memory bus and
+                cache coherence protocol
+            -   Waiting threads spin "quietly", only participating in intense
+                lock competition when necessary
+
+    -   Why back off
+
+        When the lock is released every waiter sees it at once and they all
+        exchange() together; all but one fail and go back to spinning. Each
+        failed attempt makes the next waiter wait a little longer before
+        trying again, which spreads the stampede out. After a while the
+        waiter yields instead: the holder is probably not running.
+
+    -   Correctness of memory ordering
+
+        -   exchange(..., std::memory_order_acquire): Establishes acquire semantics when acquiring the lock,
+            ensuring critical section operations are not reordered before it
+
+        -   load(std::memory_order_relaxed): During spin waiting, only atomicity is needed, not synchronization semantics,
+            so relaxed is sufficient and lightest weight
+*/
+struct alignas(kLockCacheLineSize) SpinLock
+{
+    std::atomic<bool> lock_ = {false};
+
+    void lock()
+    {
+        // Fast path, assuming the lock is free
+        if (try_lock())
+        {
+            return;
+        }
+
+        // Test with a plain load, and only exchange once the lock looks
+        // free; back off a little longer after every failed round
+        Backoff backoff;
+        do
+        {
+            backoff.pause();
+        } while (!try_lock());
+    }
+
+    void unlock()
+    {
+        // !! guarantee the critical section codes are not reordered after it
+        lock_.store(false, std::memory_order_release);
+    }
+
+    /*
+        The try_lock() should first check if the lock is free before
+        attempting to acquire it. This would prevent excessive coherency
+        traffic in case someone loops over try_lock().
+    */
+    bool try_lock() noexcept
+    {
+        return !lock_.load(std::memory_order_relaxed) &&
+               !lock_.exchange(true, std::memory_order_acquire);
+    }
+};
+
+// FIFO: a waiter's place in the queue is the ticket it took
+/*
+    Waiters back off in proportion to how many are ahead of them, so the
+    next in line polls often and the rest of the queue stays off the
+    shared line.
+*/
+class alignas(kLockCacheLineSize) TicketLock
+{
+public:
+    void lock()
+    {
+        const uint32_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+        uint32_t spins = 0;
+        while (true)
+        {
+            const uint32_t serving = serving_.load(std::memory_order_acquire);
+            if (serving == ticket)
+            {
+                return;
+            }
+
+            if (++spins > kYieldAfter)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (uint32_t i = 0, ahead = ticket - serving; i < ahead * kPausesPerWaiter; ++i)
+            {
+                cpu_relax();
+            }
+        }
+    }
+
+    bool try_lock()
+    {
+        uint32_t serving = serving_.load(std::memory_order_relaxed);
+        return next_.compare_exchange_strong(serving, serving + 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock()
+    {
+        // Only the holder writes serving_
+        serving_.store(serving_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    static constexpr uint32_t kPausesPerWaiter = 32;
+    static constexpr uint32_t kYieldAfter = 256;
+
+    std::atomic<uint32_t> next_{0};
+    std::atomic<uint32_t> serving_{0};
+};
+
+// Mellor-Crummey and Scott queue lock
+/*
+    -   The tail points at the last waiter's node. lock() swaps its own node
+        in and, if there was a predecessor, links itself behind it and spins
+        on its own node's flag until the predecessor hands the lock over.
+
+    -   lock(node)/unlock(node) take a caller-owned node, e.g. on the stack
+        for the duration of a critical section. lock()/unlock() use a node
+        from a small per-thread pool instead, so the lock is BasicLockable;
+        a thread can hold up to kMaxHeld MCS locks at once that way.
+*/
+class MCSLock
+{
+public:
+    struct alignas(kLockCacheLineSize) Node
+    {
+        std::atomic<Node*> next{nullptr};
+        std::atomic<bool> locked{false};
+    };
+
+    static constexpr size_t kMaxHeld = 8;
+
+    void lock(Node& node)
+    {
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.locked.store(true, std::memory_order_relaxed);
+
+        // acq_rel: acquire the previous holder's release if the queue was
+        // empty, release our node's initialisation to the next waiter
+        Node* predecessor = tail_.exchange(&node, std::memory_order_acq_rel);
+        if (predecessor == nullptr)
+        {
+            return;
+        }
+
+        predecessor->next.store(&node, std::memory_order_release);
+        uint32_t spins = 0;
+        while (node.locked.load(std::memory_order_acquire))
+        {
+            if (++spins > kYieldAfter)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                cpu_relax();
+            }
+        }
+    }
+
+    void unlock(Node& node)
+    {
+        Node* successor = node.next.load(std::memory_order_acquire);
+        if (successor == nullptr)
+        {
+            // Nobody behind us: leave the queue empty
+            Node* expected = &node;
+            if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            // Someone swapped in but has not linked itself yet
+            while ((successor = node.next.load(std::memory_order_acquire)) == nullptr)
+            {
+                cpu_relax();
+            }
+        }
+        successor->locked.store(false, std::memory_order_release);
+    }
+
+    void lock()
+    {
+        Node& node = thread_nodes().acquire();
+        lock(node);
+        holder_ = &node;  // only the holder reads or writes it
+    }
+
+    void unlock()
+    {
+        Node& node = *holder_;
+        unlock(node);
+        thread_nodes().release(node);
+    }
+
+private:
+    static constexpr uint32_t kYieldAfter = 256;
+
+    class NodePool
+    {
+    public:
+        Node& acquire()
+        {
+            const uint32_t index = __builtin_ctz(~in_use_);
+            if (index >= kMaxHeld)
+            {
+                throw std::bad_alloc();
+            }
+            in_use_ |= 1u << index;
+            return nodes_[index];
+        }
+
+        void release(Node& node)
+        {
+            in_use_ &= ~(1u << (&node - nodes_.data()));
+        }
+
+    private:
+        std::array<Node, kMaxHeld> nodes_;
+        uint32_t in_use_ = 0;
+    };
+
+    static NodePool& thread_nodes()
+    {
+        thread_local NodePool pool;
+        return pool;
+    }
+
+    alignas(kLockCacheLineSize) std::atomic<Node*> tail_{nullptr};
+    Node* holder_ = nullptr;
+};
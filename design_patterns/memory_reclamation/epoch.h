@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#include "thread_registry.h"
+
+// Epoch-based reclamation (EBR)
+/*
+    -   A lock-free structure cannot delete a node it has unlinked: another
+        thread may have loaded a pointer to it just before and still be
+        reading it. EBR defers the delete until every thread has provably
+        moved on.
+
+    -   Readers pin() the domain around each operation. Pinning publishes
+        the global epoch the reader saw in the reader's own record (one
+        cache line per thread, nobody else writes it) and unpinning clears
+        it: a store and a fence, no read-modify-write on shared data.
+
+    -   retire() tags an unlinked node with the current global epoch. The
+        global epoch only advances once every pinned thread has seen it, so
+        by the time it has advanced twice past a node's tag, no thread can
+        still hold a pointer to the node, and it is freed.
+
+    -   Retired nodes collect in a per-thread list and are freed in
+        batches: every kCollectEvery retires the thread tries to advance
+        the epoch and frees what has become safe, so the scan of all
+        records is amortised over many retires.
+
+    -   The catch: a thread that stays pinned, or is descheduled while
+        pinned, stops the epoch and with it all reclamation. Memory is then
+        unbounded; hazard pointers bound it, at a higher cost per read.
+
+    Up to kMaxThreads threads can use a domain at once, each through its
+    record in a ThreadRegistry. No thread may use a domain once it is
+    destroyed.
+*/
+class EpochDomain
+{
+    class Record;
+
+public:
+    static constexpr size_t kMaxThreads = 128;
+    static constexpr size_t kCollectEvery = 64;
+
+    class Guard
+    {
+    public:
+        ~Guard()
+        {
+            if (record_)
+            {
+                record_->unpin();
+            }
+        }
+
+        Guard(Guard&& other) noexcept : record_(std::exchange(other.record_, nullptr)) {}
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        friend class EpochDomain;
+
+        explicit Guard(Record* record) : record_(record)
+        {
+            record_->pin();
+        }
+
+        Record* record_;
+    };
+
+    EpochDomain() = default;
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Pointers loaded while the guard lives stay valid until it dies.
+    // Guards nest. Throws std::length_error past kMaxThreads threads.
+    [[nodiscard]] Guard pin()
+    {
+        return Guard(&thread_record());
+    }
+
+    // Deletes p two epochs from now, when no pinned thread can still hold
+    // it. Unlink p first.
+    template <typename T>
+    void retire(T* p)
+    {
+        retire(p, &delete_retired<T>);
+    }
+
+    void retire(void* p, void (*deleter)(void*))
+    {
+        Record& record = thread_record();
+        record.retired.push_back(RetiredNode{p, deleter, global_epoch_.load(std::memory_order_seq_cst)});
+        if (++record.retires_since_collect >= kCollectEvery)
+        {
+            collect(record);
+        }
+    }
+
+    // Advance the epoch if possible and free what the calling thread has
+    // retired that is safe by now
+    void collect()
+    {
+        collect(thread_record());
+    }
+
+    // Nodes the calling thread has retired that are not freed yet
+    size_t pending()
+    {
+        return thread_record().retired.size();
+    }
+
+    uint64_t epoch() const
+    {
+        return global_epoch_.load(std::memory_order_acquire);
+    }
+
+private:
+    // state: the epoch the thread pinned, shifted left, with kPinned set
+    // while it is pinned; 0 while it is not
+    class alignas(64) Record : public ThreadRegistryRecord
+    {
+    public:
+        static constexpr uint64_t kPinned = 1;
+
+        void pin()
+        {
+            if (nesting_++ == 0)
+            {
+                state.store(domain->global_epoch_.load(std::memory_order_relaxed) << 1 | kPinned, std::memory_order_relaxed);
+                // Publish the pin before loading any pointer it protects
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        void unpin()
+        {
+            if (--nesting_ == 0)
+            {
+                state.store(0, std::memory_order_release);
+            }
+        }
+
+        std::atomic<uint64_t> state{0};
+        EpochDomain* domain = nullptr;
+
+        // Owner thread only
+        size_t retires_since_collect = 0;
+
+    private:
+        uint32_t nesting_ = 0;
+    };
+
+    Record& thread_record()
+    {
+        return registry_.thread_record([this](Record& record) {
+            record.domain = this;
+            record.retires_since_collect = 0;
+            record.retired.reserve(2 * kCollectEvery);
+        });
+    }
+
+    // The epoch advances only when every pinned thread has pinned it
+    bool try_advance()
+    {
+        uint64_t epoch = global_epoch_.load(std::memory_order_seq_cst);
+        for (const Record& record : registry_.records())
+        {
+            const uint64_t state = record.state.load(std::memory_order_seq_cst);
+            if ((state & Record::kPinned) && (state >> 1) != epoch)
+            {
+                return false;
+            }
+        }
+        return global_epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+    }
+
+    void collect(Record& record)
+    {
+        record.retires_since_collect = 0;
+        try_advance();
+
+        const uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+        // Keeps what was retired less than two epochs ago
+        auto recent = [epoch](const RetiredNode& r) { return r.tag + 2 > epoch; };
+        free_retired(record.retired, recent);
+        registry_.free_orphans(recent);
+    }
+
+    alignas(64) std::atomic<uint64_t> global_epoch_{1};
+    ThreadRegistry<Record, kMaxThreads> registry_{"EpochDomain: too many threads"};
+};
+
+// Shared by every ConcurrentHashMap not given a domain
+inline EpochDomain& default_epoch_domain()
+{
+    static EpochDomain domain;
+    return domain;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+#include "hazard_pointer.h"
+
+// Treiber stack, nodes freed through hazard pointers
+/*
+    pop() protects the head before reading head->next, so the node cannot
+    be freed, and so cannot come back at the same address (ABA), while the
+    compare-exchange is pending.
+*/
+template <typename T>
+class HazardStack
+{
+public:
+    explicit HazardStack(HazardDomain& domain = default_hazard_domain()) : domain_(domain) {}
+
+    // No other thread may use the stack anymore
+    ~HazardStack()
+    {
+        for (Node* node = head_.load(std::memory_order_relaxed); node != nullptr;)
+        {
+            delete std::exchange(node, node->next);
+        }
+    }
+
+    HazardStack(const HazardStack&) = delete;
+    HazardStack& operator=(const HazardStack&) = delete;
+
+    void push(T value)
+    {
+        Node* node = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+        while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    std::optional<T> pop()
+    {
+        HazardDomain::HazardPointer hazard = domain_.make_hazard_pointer();
+        while (true)
+        {
+            Node* head = hazard.protect(head_);
+            if (head == nullptr)
+            {
+                return std::nullopt;
+            }
+
+            if (head_.compare_exchange_weak(head, head->next, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                // Only the winner of the exchange touches the value
+                std::optional<T> value(std::move(head->value));
+                hazard.reset();
+                domain_.retire(head);
+                return value;
+            }
+        }
+    }
+
+private:
+    struct Node
+    {
+        T value;
+        Node* next;
+    };
+
+    HazardDomain& domain_;
+    std::atomic<Node*> head_{nullptr};
+};
+
+// Michael-Scott queue, nodes freed through hazard pointers
+/*
+    -   The head is a dummy node; the first value lives in head->next. A
+        dequeue moves the head on to that node, which becomes the new dummy,
+        and retires the old one. An enqueue links its node behind the tail
+        and then swings the tail; anybody who finds the tail lagging swings
+        it first.
+
+    -   dequeue() protects both the head and its successor, the only node
+        whose value it reads. It copies the value out before its
+        compare-exchange: after it, the node is the new dummy and the
+        dequeuers that lost may still be reading it, so it must not be
+        moved from. T is copied, not moved, out of the queue.
+*/
+template <typename T>
+class HazardQueue
+{
+public:
+    explicit HazardQueue(HazardDomain& domain = default_hazard_domain()) : domain_(domain)
+    {
+        Node* dummy = new Node();
+        head_.store(dummy, std::memory_order_relaxed);
+        tail_.store(dummy, std::memory_order_relaxed);
+    }
+
+    // No other thread may use the queue anymore
+    ~HazardQueue()
+    {
+        for (Node* node = head_.load(std::memory_order_relaxed); node != nullptr;)
+        {
+            delete std::exchange(node, node->next.load(std::memory_order_relaxed));
+        }
+    }
+
+    HazardQueue(const HazardQueue&) = delete;
+    HazardQueue& operator=(const HazardQueue&) = delete;
+
+    void enqueue(T value)
+    {
+        Node* node = new Node(std::move(value));
+        HazardDomain::HazardPointer hazard = domain_.make_hazard_pointer();
+        while (true)
+        {
+            Node* tail = hazard.protect(tail_);
+            Node* next = tail->next.load(std::memory_order_acquire);
+            if (tail != tail_.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+
+            if (next != nullptr)
+            {
+                // The tail lags behind: help it along
+                tail_.compare_exchange_weak(tail, next, std::memory_order_release, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (tail->next.compare_exchange_weak(next, node, std::memory_order_release, std::memory_order_relaxed))
+            {
+                tail_.compare_exchange_strong(tail, node, std::memory_order_release, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    std::optional<T> dequeue()
+    {
+        HazardDomain::HazardPointer head_hazard = domain_.make_hazard_pointer();
+        HazardDomain::HazardPointer next_hazard = domain_.make_hazard_pointer();
+        while (true)
+        {
+            Node* head = head_hazard.protect(head_);
+            Node* next = next_hazard.protect(head->next);
+            if (head != head_.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+            if (next == nullptr)
+            {
+                return std::nullopt;
+            }
+
+            Node* tail = tail_.load(std::memory_order_acquire);
+            if (head == tail)
+            {
+                tail_.compare_exchange_weak(tail, next, std::memory_order_release, std::memory_order_relaxed);
+                continue;
+            }
+
+            std::optional<T> value(*next->value);
+            if (head_.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+            {
+                head_hazard.reset();
+                domain_.retire(head);
+                return value;
+            }
+        }
+    }
+
+private:
+    struct Node
+    {
+        Node() = default;
+        explicit Node(T v) : value(std::move(v)) {}
+
+        std::optional<T> value;     // empty in the first dummy
+        std::atomic<Node*> next{nullptr};
+    };
+
+    HazardDomain& domain_;
+    alignas(64) std::atomic<Node*> head_;
+    alignas(64) std::atomic<Node*> tail_;
+};
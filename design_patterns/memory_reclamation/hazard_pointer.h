@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "thread_registry.h"
+
+// Hazard pointers
+/*
+    -   Before dereferencing a shared pointer, a reader publishes it in one
+        of its hazard slots and checks that the pointer is still the one
+        shared: from then on, whoever unlinks the node sees the hazard and
+        leaves the node alone. protect() does the load, publish, recheck
+        loop.
+
+    -   retire() puts an unlinked node on the thread's retired list. Once
+        the list is long enough, a scan reads every hazard slot once, sorts
+        them, and frees each retired node no slot points to. The threshold
+        grows with the number of slots (twice the slots in use, plus a
+        constant), so every scan frees at least half of what it looks at:
+        amortised O(1) work per retire.
+
+    -   Compared to EBR: each protected pointer costs a store and a full
+        fence, not one per operation, and a scan reads every slot. But a
+        stalled reader holds back only the few nodes its slots point to, so
+        the memory that is retired and not freed stays bounded however long
+        a reader is descheduled.
+
+    Each thread has kSlotsPerThread hazard slots, handed out by
+    make_hazard_pointer() and returned when the HazardPointer dies. Threads
+    get their records from a ThreadRegistry, up to kMaxThreads at once;
+    none may use the domain once it is destroyed.
+*/
+class HazardDomain
+{
+    class Record;
+
+public:
+    static constexpr size_t kMaxThreads = 128;
+    static constexpr size_t kSlotsPerThread = 4;
+    static constexpr size_t kScanSlack = 64;
+
+    // Owns one hazard slot of the calling thread
+    class HazardPointer
+    {
+    public:
+        ~HazardPointer()
+        {
+            if (record_)
+            {
+                reset();
+                record_->release_slot(slot_);
+            }
+        }
+
+        HazardPointer(HazardPointer&& other) noexcept
+            : record_(std::exchange(other.record_, nullptr)), slot_(other.slot_)
+        {
+        }
+
+        HazardPointer(const HazardPointer&) = delete;
+        HazardPointer& operator=(const HazardPointer&) = delete;
+
+        // Loads source and keeps what it loaded alive until the next
+        // protect() or reset()
+        template <typename T>
+        T* protect(const std::atomic<T*>& source)
+        {
+            T* pointer = source.load(std::memory_order_relaxed);
+            while (true)
+            {
+                hazard().store(pointer, std::memory_order_seq_cst);
+                T* again = source.load(std::memory_order_seq_cst);
+                if (again == pointer)
+                {
+                    return pointer;
+                }
+                pointer = again;
+            }
+        }
+
+        void reset()
+        {
+            hazard().store(nullptr, std::memory_order_release);
+        }
+
+    private:
+        friend class HazardDomain;
+
+        HazardPointer(Record* record, size_t slot) : record_(record), slot_(slot) {}
+
+        std::atomic<const void*>& hazard()
+        {
+            return record_->hazards[slot_];
+        }
+
+        Record* record_;
+        size_t slot_;
+    };
+
+    HazardDomain() = default;
+
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+
+    // Throws std::length_error if the thread has no free slot left, or
+    // past kMaxThreads threads
+    [[nodiscard]] HazardPointer make_hazard_pointer()
+    {
+        Record& record = thread_record();
+        return HazardPointer(&record, record.acquire_slot());
+    }
+
+    // Deletes p once no hazard slot points to it. Unlink it first, or a
+    // reader could protect it again after the scan.
+    template <typename T>
+    void retire(T* p)
+    {
+        retire(p, &delete_retired<T>);
+    }
+
+    void retire(void* p, void (*deleter)(void*))
+    {
+        Record& record = thread_record();
+        record.retired.push_back(RetiredNode{p, deleter});
+        if (record.retired.size() >= scan_threshold())
+        {
+            scan(record);
+        }
+    }
+
+    // Free what the calling thread has retired and nobody protects
+    void reclaim()
+    {
+        scan(thread_record());
+    }
+
+    // Nodes on the calling thread's retired list, still protected or
+    // not scanned yet
+    size_t pending()
+    {
+        return thread_record().retired.size();
+    }
+
+private:
+    class alignas(64) Record : public ThreadRegistryRecord
+    {
+    public:
+        size_t acquire_slot()
+        {
+            const uint32_t slot = __builtin_ctz(~used_slots_);
+            if (slot >= kSlotsPerThread)
+            {
+                throw std::length_error("HazardDomain: no hazard slot left");
+            }
+            used_slots_ |= 1u << slot;
+            return slot;
+        }
+
+        void release_slot(size_t slot)
+        {
+            used_slots_ &= ~(1u << slot);
+        }
+
+        std::array<std::atomic<const void*>, kSlotsPerThread> hazards{};
+
+        // Owner thread only
+        std::vector<const void*> scratch;
+
+    private:
+        uint32_t used_slots_ = 0;
+    };
+
+    Record& thread_record()
+    {
+        return registry_.thread_record([this](Record& record) {
+            record.retired.reserve(scan_threshold());
+            record.scratch.reserve(kMaxThreads * kSlotsPerThread);
+        });
+    }
+
+    size_t scan_threshold() const
+    {
+        return 2 * registry_.threads() * kSlotsPerThread + kScanSlack;
+    }
+
+    void scan(Record& record)
+    {
+        // Order the unlinks before the hazard loads: a reader that
+        // published its hazard too late rechecks and sees the unlink
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::vector<const void*>& hazards = record.scratch;
+        hazards.clear();
+        for (const Record& other : registry_.records())
+        {
+            for (const std::atomic<const void*>& hazard : other.hazards)
+            {
+                if (const void* pointer = hazard.load(std::memory_order_acquire))
+                {
+                    hazards.push_back(pointer);
+                }
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        auto is_hazard = [&hazards](const RetiredNode& r) {
+            return std::binary_search(hazards.begin(), hazards.end(), r.pointer);
+        };
+        free_retired(record.retired, is_hazard);
+        registry_.free_orphans(is_hazard);
+    }
+
+    ThreadRegistry<Record, kMaxThreads> registry_{"HazardDomain: too many threads"};
+};
+
+// Used by HazardStack and HazardQueue unless they are given a domain
+inline HazardDomain& default_hazard_domain()
+{
+    static HazardDomain domain;
+    return domain;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "thread_registry.h"
+
+// Quiescent-state-based reclamation (QSBR)
+/*
+    -   EBR makes every read pin the domain, a store and a fence. QSBR
+        moves that cost out of the read altogether: a reader thread
+        registers once and then, between operations, at a point where it
+        holds no pointer into any shared structure, announces a quiescent
+        state. A read is then just the load of the pointer.
+
+    -   Announcing copies the global grace period counter into the reader's
+        own record (one cache line per reader, nobody else writes it): a
+        load and a release store, no fence, no read-modify-write. A
+        message loop does it once per message.
+
+    -   retire() bumps the counter and tags the node with the new value.
+        Once every online reader's record has caught up with the tag, each
+        has been quiescent since the node was unlinked, and the node is
+        freed. Writers never wait: nodes are freed by a later retire() or
+        collect().
+
+    -   The catch: a reader that is online but does not announce, e.g. one
+        that blocks, holds up all reclamation. A reader goes offline()
+        around anything that may block and comes back online() after.
+
+    Up to kMaxReaders readers can be registered at once. A domain must
+    outlive its readers.
+*/
+class QsbrDomain
+{
+    class Record;
+
+public:
+    static constexpr size_t kMaxReaders = 128;
+
+    // A registered reader thread; online while it lives
+    class Reader
+    {
+    public:
+        ~Reader()
+        {
+            if (record_)
+            {
+                record_->seen.store(kOffline, std::memory_order_release);
+                record_->claimed.store(false, std::memory_order_release);
+            }
+        }
+
+        Reader(Reader&& other) noexcept : domain_(other.domain_), record_(std::exchange(other.record_, nullptr)) {}
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // No pointer loaded before is used after
+        void quiescent()
+        {
+            record_->seen.store(domain_->grace_period_.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        // Quiescent until online() again, e.g. while blocked
+        void offline()
+        {
+            record_->seen.store(kOffline, std::memory_order_release);
+        }
+
+        void online()
+        {
+            record_->seen.store(domain_->grace_period_.load(std::memory_order_acquire), std::memory_order_relaxed);
+            // Publish the record before loading any pointer it protects
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+    private:
+        friend class QsbrDomain;
+
+        Reader(QsbrDomain* domain, Record* record) : domain_(domain), record_(record)
+        {
+            online();
+        }
+
+        QsbrDomain* domain_;
+        Record* record_;
+    };
+
+    QsbrDomain() = default;
+
+    // Every reader must be gone: what is left retired is freed regardless
+    ~QsbrDomain()
+    {
+        free_retired(retired_);
+    }
+
+    QsbrDomain(const QsbrDomain&) = delete;
+    QsbrDomain& operator=(const QsbrDomain&) = delete;
+
+    // Throws std::length_error past kMaxReaders readers
+    [[nodiscard]] Reader register_reader()
+    {
+        for (Record& record : records_)
+        {
+            bool claimed = false;
+            if (!record.claimed.load(std::memory_order_relaxed) &&
+                record.claimed.compare_exchange_strong(claimed, true, std::memory_order_acquire))
+            {
+                return Reader(this, &record);
+            }
+        }
+        throw std::length_error("QsbrDomain: too many readers");
+    }
+
+    // Deletes p after a grace period. Unlinking p comes first; readers
+    // that loaded it before then keep it alive until they are quiescent.
+    template <typename T>
+    void retire(T* p)
+    {
+        retire(p, &delete_retired<T>);
+    }
+
+    void retire(void* p, void (*deleter)(void*))
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        const uint64_t tag = grace_period_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        retired_.push_back(RetiredNode{p, deleter, tag});
+        collect_locked();
+    }
+
+    // Frees what every online reader has been quiescent since
+    void collect()
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        collect_locked();
+    }
+
+    // Nodes retired and not freed yet
+    size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        return retired_.size();
+    }
+
+private:
+    static constexpr uint64_t kOffline = 0;
+
+    // seen: the grace period the reader last announced, kOffline while
+    // it is offline or unregistered
+    struct alignas(64) Record
+    {
+        std::atomic<uint64_t> seen{kOffline};
+        std::atomic<bool> claimed{false};
+    };
+
+    void collect_locked()
+    {
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (const Record& record : records_)
+        {
+            const uint64_t seen = record.seen.load(std::memory_order_seq_cst);
+            if (seen != kOffline)
+            {
+                oldest = std::min(oldest, seen);
+            }
+        }
+
+        free_retired(retired_, [oldest](const RetiredNode& r) { return r.tag > oldest; });
+    }
+
+    alignas(64) std::atomic<uint64_t> grace_period_{1};
+    std::array<Record, kMaxReaders> records_;
+
+    std::mutex retired_mutex_;
+    std::vector<RetiredNode> retired_;
+};
+
+// RcuSnapshot's domain when none is passed in
+inline QsbrDomain& default_qsbr_domain()
+{
+    static QsbrDomain domain;
+    return domain;
+}
@@ -0,0 +1,141 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "../lock_free/shared_fixture.h"
+#include "qsbr.h"
+#include "rcu_snapshot.h"
+
+// Note
+/*
+    Instrument reference data: every message checks an order against its
+    instrument's price band and tick size, and the data is replaced now
+    and then. Thread 0 also republishes it every kPublishEvery messages,
+    far more often than a few times a day, so that the writer shows.
+
+    -   SharedMutexReference: every message takes the shared lock, an
+        atomic read-modify-write on the lock word, a line all the readers
+        write. Republishing takes it exclusively and stops every reader.
+    -   RcuReference: a message loads the current version and announces a
+        quiescent state after it, a load and a store to the reader's own
+        record. Republishing never stops a reader; the old version is
+        freed once every reader has moved past it.
+*/
+constexpr size_t kInstruments = 4096;
+constexpr uint64_t kPublishEvery = 1 << 14;
+
+struct Instrument
+{
+    uint64_t id;
+    uint32_t tick_size;
+    uint32_t lot_size;
+    uint64_t low;
+    uint64_t high;
+};
+
+using ReferenceData = std::vector<Instrument>;
+
+ReferenceData make_reference_data(uint64_t version)
+{
+    ReferenceData data(kInstruments);
+    for (size_t i = 0; i < kInstruments; ++i)
+    {
+        data[i] = Instrument{i, 5, 100, 1000 + version % 16, 100000};
+    }
+    return data;
+}
+
+bool check_order(const Instrument& instrument, uint64_t price, uint32_t shares)
+{
+    return price >= instrument.low && price <= instrument.high && price % instrument.tick_size == 0 &&
+           shares % instrument.lot_size == 0;
+}
+
+class SharedMutexReference
+{
+public:
+    struct Reader
+    {
+        void quiescent() {}
+    };
+
+    Reader reader()
+    {
+        return Reader();
+    }
+
+    bool check(Reader&, uint64_t instrument, uint64_t price, uint32_t shares)
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return check_order(data_[instrument], price, shares);
+    }
+
+    void publish(uint64_t version)
+    {
+        ReferenceData next = make_reference_data(version);
+        std::lock_guard<std::shared_mutex> lock(mutex_);
+        data_.swap(next);
+    }
+
+private:
+    std::shared_mutex mutex_;
+    ReferenceData data_ = make_reference_data(0);
+};
+
+class RcuReference
+{
+public:
+    using Reader = QsbrDomain::Reader;
+
+    Reader reader()
+    {
+        return domain_.register_reader();
+    }
+
+    bool check(Reader& reader, uint64_t instrument, uint64_t price, uint32_t shares)
+    {
+        return check_order((*data_.read(reader))[instrument], price, shares);
+    }
+
+    void publish(uint64_t version)
+    {
+        data_.publish(make_reference_data(version));
+    }
+
+private:
+    QsbrDomain domain_;
+    RcuSnapshot<ReferenceData> data_{make_reference_data(0), domain_};
+};
+
+template <typename Reference>
+void check_orders(benchmark::State& state, Reference& reference)
+{
+    typename Reference::Reader reader = reference.reader();
+    uint64_t messages = 0;
+    uint64_t version = 0;
+    int64_t accepted = 0;
+
+    for (auto _ : state)
+    {
+        ++messages;
+        if (state.thread_index() == 0 && messages % kPublishEvery == 0)
+        {
+            reference.publish(++version);
+        }
+
+        accepted += reference.check(reader, (messages * 2654435761u) % kInstruments, 1000 + messages % 64 * 5, 100);
+        reader.quiescent();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["accepted"] = benchmark::Counter(accepted, benchmark::Counter::kAvgThreads);
+}
+
+SHARED_BENCHMARK(SharedMutexReference, check_orders, SharedMutexReference)->ThreadRange(1, 16);
+
+SHARED_BENCHMARK(RcuReference, check_orders, RcuReference)->ThreadRange(1, 16);
+
+BENCHMARK_MAIN();
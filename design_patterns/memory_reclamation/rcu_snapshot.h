@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "qsbr.h"
+
+// Read-copy-update cell holding an immutable T, old versions freed
+// through QSBR
+/*
+    For data read all the time and replaced rarely, e.g. instrument
+    reference data. read() is one acquire load of the current version; the
+    version stays valid until the reader's next quiescent(). A writer
+    builds the next version aside, swaps it in and retires the old one;
+    writers are serialized by a mutex, readers never see it.
+*/
+template <typename T>
+class RcuSnapshot
+{
+public:
+    explicit RcuSnapshot(T initial, QsbrDomain& domain = default_qsbr_domain())
+        : domain_(domain), current_(new T(std::move(initial)))
+    {
+    }
+
+    // No reader may use the snapshot anymore
+    ~RcuSnapshot()
+    {
+        delete current_.load(std::memory_order_relaxed);
+    }
+
+    RcuSnapshot(const RcuSnapshot&) = delete;
+    RcuSnapshot& operator=(const RcuSnapshot&) = delete;
+
+    // reader must be online and registered with this snapshot's domain
+    const T* read(const QsbrDomain::Reader&) const
+    {
+        return current_.load(std::memory_order_acquire);
+    }
+
+    void publish(T next)
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        publish_locked(new T(std::move(next)));
+    }
+
+    // Publishes a copy of the current version with f applied
+    template <typename F>
+    void update(F&& f)
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        auto next = std::make_unique<T>(*current_.load(std::memory_order_relaxed));
+        std::forward<F>(f)(*next);
+        publish_locked(next.release());
+    }
+
+private:
+    void publish_locked(T* next)
+    {
+        // seq_cst: a reader coming online() either sees next or holds up
+        // the old version's grace period
+        const T* old = current_.exchange(next, std::memory_order_seq_cst);
+        domain_.retire(const_cast<T*>(old));
+    }
+
+    QsbrDomain& domain_;
+    alignas(64) std::atomic<const T*> current_;
+    std::mutex writer_mutex_;
+};
@@ -0,0 +1,267 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "../lock_free/shared_fixture.h"
+#include "epoch.h"
+#include "hazard_containers.h"
+#include "hazard_pointer.h"
+
+// Note
+/*
+    Readers follow a shared pointer to an immutable snapshot while one
+    writer keeps replacing it, i.e. the reads of a lock-free structure
+    racing with the unlinks. The question is what each read pays so that
+    the writer can free the old snapshot.
+
+    -   shared_ptr: every read copies the pointer, an atomic increment and
+        decrement of the snapshot's reference count, a line every reader
+        writes (see the shared_ptr copies in test.cc). libstdc++'s
+        atomic<shared_ptr> also takes a spin lock bit around the load.
+    -   EBR: a read publishes the epoch in the reader's own record and
+        fences; the snapshot's line is only ever read. The writer frees old
+        snapshots in batches, every EpochDomain::kCollectEvery replaces.
+    -   Hazard pointers: a read publishes the snapshot in a hazard slot and
+        fences, about what EBR pays for one protected pointer; a structure
+        that protects several nodes per operation pays it several times.
+
+    Thread 0 writes, the others read: 1, 2, 4 and 8 readers.
+
+    The Stalled variants add one more reader that protects a snapshot and
+    then sits on it for the whole run, like a descheduled thread. EBR
+    cannot advance the epoch past it and frees nothing; hazard pointers
+    keep freeing everything but that one snapshot. peak_pending is the
+    most snapshots the writer had retired and not yet freed.
+*/
+struct Snapshot
+{
+    std::array<uint64_t, 8> values;
+};
+
+Snapshot* make_snapshot(uint64_t version)
+{
+    Snapshot* snapshot = new Snapshot;
+    snapshot->values.fill(version);
+    return snapshot;
+}
+
+class SharedPtrCell
+{
+public:
+    SharedPtrCell() : current_(std::shared_ptr<const Snapshot>(make_snapshot(0))) {}
+
+    uint64_t read(size_t index)
+    {
+        const std::shared_ptr<const Snapshot> snapshot = current_.load(std::memory_order_acquire);
+        return snapshot->values[index];
+    }
+
+    void replace(uint64_t version)
+    {
+        current_.store(std::shared_ptr<const Snapshot>(make_snapshot(version)), std::memory_order_release);
+    }
+
+private:
+    std::atomic<std::shared_ptr<const Snapshot>> current_;
+};
+
+class EpochCell
+{
+public:
+    EpochCell() : current_(make_snapshot(0)) {}
+
+    ~EpochCell()
+    {
+        delete current_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t read(size_t index)
+    {
+        EpochDomain::Guard guard = domain_.pin();
+        return current_.load(std::memory_order_acquire)->values[index];
+    }
+
+    void replace(uint64_t version)
+    {
+        Snapshot* old = current_.exchange(make_snapshot(version), std::memory_order_acq_rel);
+        domain_.retire(old);
+    }
+
+    // Stays pinned until stop is set
+    void stall(const std::atomic<bool>& stop)
+    {
+        EpochDomain::Guard guard = domain_.pin();
+        benchmark::DoNotOptimize(current_.load(std::memory_order_acquire));
+        while (!stop.load(std::memory_order_acquire))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    size_t pending()
+    {
+        return domain_.pending();
+    }
+
+private:
+    std::atomic<Snapshot*> current_;
+    EpochDomain domain_;
+};
+
+class HazardCell
+{
+public:
+    HazardCell() : current_(make_snapshot(0)) {}
+
+    ~HazardCell()
+    {
+        delete current_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t read(size_t index)
+    {
+        HazardDomain::HazardPointer hazard = domain_.make_hazard_pointer();
+        return hazard.protect(current_)->values[index];
+    }
+
+    void replace(uint64_t version)
+    {
+        Snapshot* old = current_.exchange(make_snapshot(version), std::memory_order_acq_rel);
+        domain_.retire(old);
+    }
+
+    // Holds on to the current snapshot until stop is set
+    void stall(const std::atomic<bool>& stop)
+    {
+        HazardDomain::HazardPointer hazard = domain_.make_hazard_pointer();
+        benchmark::DoNotOptimize(hazard.protect(current_));
+        while (!stop.load(std::memory_order_acquire))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    size_t pending()
+    {
+        return domain_.pending();
+    }
+
+private:
+    std::atomic<Snapshot*> current_;
+    HazardDomain domain_;
+};
+
+template <typename Cell>
+void read_replace(benchmark::State& state, Cell& cell)
+{
+    int64_t reads = 0;
+    int64_t writes = 0;
+    uint64_t sum = 0;
+
+    for (auto _ : state)
+    {
+        if (state.thread_index() == 0)
+        {
+            cell.replace(++writes);
+        }
+        else
+        {
+            sum += cell.read(reads++ & 7);
+        }
+    }
+
+    benchmark::DoNotOptimize(sum);
+    state.counters["reads"] = benchmark::Counter(reads, benchmark::Counter::kIsRate);
+    state.counters["writes"] = benchmark::Counter(writes, benchmark::Counter::kIsRate);
+}
+
+// As read_replace, with a stalled reader next to the others
+template <typename Cell>
+void read_replace_stalled(benchmark::State& state, Cell& cell)
+{
+    static std::atomic<bool> stop{false};
+    std::thread stalled;
+    if (state.thread_index() == 0)
+    {
+        stop.store(false, std::memory_order_relaxed);
+        stalled = std::thread([&cell]() { cell.stall(stop); });
+    }
+
+    int64_t reads = 0;
+    int64_t writes = 0;
+    size_t peak_pending = 0;
+    uint64_t sum = 0;
+
+    for (auto _ : state)
+    {
+        if (state.thread_index() == 0)
+        {
+            cell.replace(++writes);
+            peak_pending = std::max(peak_pending, cell.pending());
+        }
+        else
+        {
+            sum += cell.read(reads++ & 7);
+        }
+    }
+
+    if (state.thread_index() == 0)
+    {
+        stop.store(true, std::memory_order_release);
+        stalled.join();
+    }
+
+    benchmark::DoNotOptimize(sum);
+    state.counters["reads"] = benchmark::Counter(reads, benchmark::Counter::kIsRate);
+    state.counters["writes"] = benchmark::Counter(writes, benchmark::Counter::kIsRate);
+    state.counters["peak_pending"] = benchmark::Counter(peak_pending);
+}
+
+SHARED_BENCHMARK(SharedPtr, read_replace, SharedPtrCell)
+    ->Threads(2)->Threads(3)->Threads(5)->Threads(9);
+
+SHARED_BENCHMARK(Epoch, read_replace, EpochCell)
+    ->Threads(2)->Threads(3)->Threads(5)->Threads(9);
+
+SHARED_BENCHMARK(Hazard, read_replace, HazardCell)
+    ->Threads(2)->Threads(3)->Threads(5)->Threads(9);
+
+SHARED_BENCHMARK(EpochStalled, read_replace_stalled, EpochCell)->Threads(2);
+
+SHARED_BENCHMARK(HazardStalled, read_replace_stalled, HazardCell)->Threads(2);
+
+// Every thread pushes and pops in turn
+template <typename T>
+void push_pop(benchmark::State& state, HazardStack<T>& stack)
+{
+    T value = 0;
+    for (auto _ : state)
+    {
+        stack.push(++value);
+        benchmark::DoNotOptimize(stack.pop());
+    }
+    state.SetItemsProcessed(2 * state.iterations());
+}
+
+template <typename T>
+void enqueue_dequeue(benchmark::State& state, HazardQueue<T>& queue)
+{
+    T value = 0;
+    for (auto _ : state)
+    {
+        queue.enqueue(++value);
+        benchmark::DoNotOptimize(queue.dequeue());
+    }
+    state.SetItemsProcessed(2 * state.iterations());
+}
+
+SHARED_BENCHMARK(HazardStack, push_pop, HazardStack<uint64_t>)->ThreadRange(1, 8);
+
+SHARED_BENCHMARK(HazardQueue, enqueue_dequeue, HazardQueue<uint64_t>)->ThreadRange(1, 8);
+
+BENCHMARK_MAIN();
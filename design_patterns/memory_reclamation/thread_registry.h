@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// A node unlinked from a shared structure and waiting to be freed. tag is
+// whatever the domain needs to decide when that is safe: the epoch or the
+// grace period it was retired in.
+struct RetiredNode
+{
+    void* pointer;
+    void (*deleter)(void*);
+    uint64_t tag = 0;
+};
+
+template <typename T>
+void delete_retired(void* p)
+{
+    delete static_cast<T*>(p);
+}
+
+// Frees the nodes keep() rejects, in place
+template <typename Keep>
+void free_retired(std::vector<RetiredNode>& retired, Keep keep)
+{
+    auto freed = std::partition(retired.begin(), retired.end(), keep);
+    for (auto it = freed; it != retired.end(); ++it)
+    {
+        it->deleter(it->pointer);
+    }
+    retired.erase(freed, retired.end());
+}
+
+inline void free_retired(std::vector<RetiredNode>& retired)
+{
+    free_retired(retired, [](const RetiredNode&) { return false; });
+}
+
+// What every per-thread record of a reclamation domain has
+struct ThreadRegistryRecord
+{
+    std::atomic<bool> claimed{false};
+
+    // Owner thread only
+    std::vector<RetiredNode> retired;
+};
+
+// Per-thread records of a reclamation domain
+/*
+    -   A thread claims a record the first time it uses the domain, and the
+        record stays the thread's until it exits: lookups after the first
+        hit a thread_local cache keyed by the registry's id, not its
+        address, which a later registry may reuse.
+
+    -   When the thread exits its record is released for another thread to
+        claim. Nodes it retired that were not safe to free yet become
+        orphans, which the domain frees later through free_orphans().
+
+    -   The registry frees whatever is still retired when it is destroyed:
+        no thread may use the domain by then. Threads that used it may
+        still be alive, e.g. a benchmark's main thread across runs that
+        each build a new domain; their exit then skips the dead registry.
+
+    Record derives from ThreadRegistryRecord.
+*/
+template <typename Record, size_t MaxThreads>
+class ThreadRegistry
+{
+public:
+    explicit ThreadRegistry(const char* overflow_message)
+        : id_(next_id()), overflow_message_(overflow_message), lifetime_(std::make_shared<Lifetime>(this))
+    {
+    }
+
+    ~ThreadRegistry()
+    {
+        {
+            std::lock_guard<std::mutex> lock(lifetime_->mutex);
+            lifetime_->registry = nullptr;
+        }
+        for (Record& record : records_)
+        {
+            free_retired(record.retired);
+        }
+        free_retired(orphans_);
+    }
+
+    ThreadRegistry(const ThreadRegistry&) = delete;
+    ThreadRegistry& operator=(const ThreadRegistry&) = delete;
+
+    // The calling thread's record; on_claim(record) runs when the thread
+    // first gets it. Throws std::length_error past MaxThreads threads.
+    template <typename OnClaim>
+    Record& thread_record(OnClaim&& on_claim)
+    {
+        thread_local uint64_t cached_registry = 0;
+        thread_local Record* cached_record = nullptr;
+        thread_local ThreadRecords records;
+
+        if (cached_registry != id_) [[unlikely]]
+        {
+            auto it = std::find_if(records.entries.begin(), records.entries.end(),
+                                   [this](const typename ThreadRecords::Entry& entry) { return entry.registry_id == id_; });
+            if (it == records.entries.end())
+            {
+                Record& record = claim();
+                on_claim(record);
+                std::erase_if(records.entries, [](const typename ThreadRecords::Entry& entry) {
+                    std::lock_guard<std::mutex> lock(entry.lifetime->mutex);
+                    return entry.lifetime->registry == nullptr;
+                });
+                records.entries.push_back(typename ThreadRecords::Entry{id_, lifetime_, &record});
+                it = records.entries.end() - 1;
+            }
+            cached_registry = id_;
+            cached_record = it->record;
+        }
+        return *cached_record;
+    }
+
+    std::array<Record, MaxThreads>& records()
+    {
+        return records_;
+    }
+
+    // Threads holding a record
+    size_t threads() const
+    {
+        return threads_.load(std::memory_order_relaxed);
+    }
+
+    // Frees the orphans keep() rejects; skipped while another thread is
+    // at it or a thread is exiting, the next call catches up
+    template <typename Keep>
+    void free_orphans(Keep keep)
+    {
+        std::unique_lock<std::mutex> lock(orphans_mutex_, std::try_to_lock);
+        if (lock.owns_lock() && !orphans_.empty())
+        {
+            free_retired(orphans_, keep);
+        }
+    }
+
+private:
+    // Shared with the threads holding a record; registry is nullptr once
+    // the registry is gone
+    struct Lifetime
+    {
+        explicit Lifetime(ThreadRegistry* r) : registry(r) {}
+
+        std::mutex mutex;
+        ThreadRegistry* registry;
+    };
+
+    // Releases the thread's records when it exits
+    struct ThreadRecords
+    {
+        struct Entry
+        {
+            uint64_t registry_id;
+            std::shared_ptr<Lifetime> lifetime;
+            Record* record;
+        };
+
+        ~ThreadRecords()
+        {
+            for (const Entry& entry : entries)
+            {
+                std::lock_guard<std::mutex> lock(entry.lifetime->mutex);
+                if (entry.lifetime->registry != nullptr)
+                {
+                    entry.lifetime->registry->release(*entry.record);
+                }
+            }
+        }
+
+        std::vector<Entry> entries;
+    };
+
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> ids{0};
+        return ++ids;
+    }
+
+    Record& claim()
+    {
+        for (Record& record : records_)
+        {
+            bool claimed = false;
+            if (!record.claimed.load(std::memory_order_relaxed) &&
+                record.claimed.compare_exchange_strong(claimed, true, std::memory_order_acquire))
+            {
+                threads_.fetch_add(1, std::memory_order_relaxed);
+                return record;
+            }
+        }
+        throw std::length_error(overflow_message_);
+    }
+
+    void release(Record& record)
+    {
+        if (!record.retired.empty())
+        {
+            std::lock_guard<std::mutex> lock(orphans_mutex_);
+            orphans_.insert(orphans_.end(), record.retired.begin(), record.retired.end());
+            record.retired.clear();
+        }
+        threads_.fetch_sub(1, std::memory_order_relaxed);
+        record.claimed.store(false, std::memory_order_release);
+    }
+
+    const uint64_t id_;
+    const char* overflow_message_;
+    std::shared_ptr<Lifetime> lifetime_;
+    std::atomic<size_t> threads_{0};
+    std::array<Record, MaxThreads> records_;
+
+    std::mutex orphans_mutex_;
+    std::vector<RetiredNode> orphans_;
+};
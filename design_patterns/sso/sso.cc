@@ -1,4 +1,6 @@
 #include <benchmark/benchmark.h>
+#include "fixed_string.h"
+#include <map>
 #include <string>
 #include <vector>
 #include <array>
@@ -206,6 +208,74 @@ static void BM_MapLongStringKeys(benchmark::State& state) {
 }
 BENCHMARK(BM_MapLongStringKeys)->Arg(100)->Arg(1000);
 
+// FixedString vs std::string
+// Inline storage and a length byte: copying never allocates, whatever the
+// length, as long as it fits the capacity. Lengths straddle the SSO threshold.
+using Fixed = FixedString<63>;
+
+static void BM_Copy_StdString(benchmark::State& state) {
+    std::string source(state.range(0), 'x');
+    for (auto _ : state) {
+        std::string copy = source;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetLabel("length=" + std::to_string(state.range(0)));
+}
+BENCHMARK(BM_Copy_StdString)->Arg(8)->Arg(15)->Arg(16)->Arg(32)->Arg(63);
+
+static void BM_Copy_FixedString(benchmark::State& state) {
+    Fixed source(std::string(state.range(0), 'x'));
+    for (auto _ : state) {
+        Fixed copy = source;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetLabel("length=" + std::to_string(state.range(0)));
+}
+BENCHMARK(BM_Copy_FixedString)->Arg(8)->Arg(15)->Arg(16)->Arg(32)->Arg(63);
+
+// Equal strings, so the whole length is compared
+static void BM_Compare_StdString(benchmark::State& state) {
+    std::string a(state.range(0), 'x');
+    std::string b(state.range(0), 'x');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(a == b);
+    }
+    state.SetLabel("length=" + std::to_string(state.range(0)));
+}
+BENCHMARK(BM_Compare_StdString)->Arg(8)->Arg(15)->Arg(16)->Arg(32)->Arg(63);
+
+static void BM_Compare_FixedString(benchmark::State& state) {
+    Fixed a(std::string(state.range(0), 'x'));
+    Fixed b(std::string(state.range(0), 'x'));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(a == b);
+    }
+    state.SetLabel("length=" + std::to_string(state.range(0)));
+}
+BENCHMARK(BM_Compare_FixedString)->Arg(8)->Arg(15)->Arg(16)->Arg(32)->Arg(63);
+
+static void BM_Hash_StdString(benchmark::State& state) {
+    std::string s(state.range(0), 'x');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(s);
+        benchmark::DoNotOptimize(std::hash<std::string>{}(s));
+    }
+    state.SetLabel("length=" + std::to_string(state.range(0)));
+}
+BENCHMARK(BM_Hash_StdString)->Arg(8)->Arg(15)->Arg(16)->Arg(32)->Arg(63);
+
+static void BM_Hash_FixedString(benchmark::State& state) {
+    Fixed s(std::string(state.range(0), 'x'));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(s);
+        benchmark::DoNotOptimize(std::hash<Fixed>{}(s));
+    }
+    state.SetLabel("length=" + std::to_string(state.range(0)));
+}
+BENCHMARK(BM_Hash_FixedString)->Arg(8)->Arg(15)->Arg(16)->Arg(32)->Arg(63);
+
 // Simple SSO detection (heuristic)
 void demonstrate_sso_threshold() {
     std::cout << "SSO Threshold Detection:\n";
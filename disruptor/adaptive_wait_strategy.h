@@ -0,0 +1,124 @@
+#pragma once
+
+#include "tsc.h"
+#include "wait_strategy.h"
+#include <algorithm>
+#include <atomic>
+#include <immintrin.h>
+#include <thread>
+
+// Spin, yield, then park, with a spin budget tuned from the observed traffic
+/*
+    -   Every idle period (from the first wait_for() that finds nothing to
+        the next event) is timed with rdtsc and folded into a moving average.
+
+    -   If events typically arrive within max_spin_ns, the consumer spins
+        for spin_factor times the average gap with pause, so most of them
+        are picked up without a syscall. If gaps are longer than that,
+        spinning would only burn the core, so the budget drops to
+        min_spin_ns and the consumer parks almost at once.
+
+    -   max_spin_ns is the knob: the most CPU one idle period may burn to
+        save the wake-up latency of a park (a few microseconds).
+
+    -   The chosen budget is published with a relaxed store for the metrics
+        snapshot to report.
+*/
+class AdaptiveWaitStrategy : public WaitStrategy<AdaptiveWaitStrategy>
+{
+public:
+    static constexpr bool kBlocking = true;
+
+    explicit AdaptiveWaitStrategy(uint64_t max_spin_ns = 50'000, uint64_t min_spin_ns = 1'000,
+                                  double spin_factor = 2.0, int yield_iterations = 8)
+        : max_spin_cycles_(ns_to_cycles(max_spin_ns)), min_spin_cycles_(ns_to_cycles(min_spin_ns)),
+        spin_factor_(spin_factor), yield_iterations_(yield_iterations)
+    {
+        spin_budget_cycles_.store(max_spin_cycles_, std::memory_order_relaxed);
+    }
+
+    void waitImpl()
+    {
+        _mm_pause();
+    }
+
+    long wait_for_impl(long sequence, Sequencer& sequencer, const std::atomic<bool>& running)
+    {
+        const uint64_t now = rdtsc();
+        if (idle_start_ == 0)
+        {
+            idle_start_ = now;
+        }
+
+        long available;
+
+        // 1. Busy spin within the budget
+        const uint64_t spin_deadline = now + spin_budget_cycles_.load(std::memory_order_relaxed);
+        do
+        {
+            if ((available = sequencer.cursor()) >= sequence)
+            {
+                return on_arrival(available);
+            }
+            _mm_pause();
+        }
+        while (rdtsc() < spin_deadline);
+
+        // 2. Give the core away a few times before paying for a syscall
+        for (int i = 0; i < yield_iterations_; ++i)
+        {
+            if ((available = sequencer.cursor()) >= sequence)
+            {
+                return on_arrival(available);
+            }
+            std::this_thread::yield();
+        }
+
+        // 3. Park until the producer wakes us
+        available = sequencer.wait_for_publish(sequence, running);
+        return available >= sequence ? on_arrival(available) : available;
+    }
+
+    // Fold one idle period into the average and pick the next budget
+    void record_idle_period(uint64_t cycles)
+    {
+        average_gap_cycles_ += (static_cast<double>(cycles) - average_gap_cycles_) / kAverageWindow;
+
+        const double wanted = average_gap_cycles_ * spin_factor_;
+        const uint64_t budget = wanted <= static_cast<double>(max_spin_cycles_)
+            ? std::max(min_spin_cycles_, static_cast<uint64_t>(wanted))
+            : min_spin_cycles_;
+
+        spin_budget_cycles_.store(budget, std::memory_order_relaxed);
+    }
+
+    // Safe to read from any thread
+    uint64_t spin_budget_cycles() const
+    {
+        return spin_budget_cycles_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr double kAverageWindow = 8.0;
+
+    static uint64_t ns_to_cycles(uint64_t ns)
+    {
+        return ns * tsc_per_milli() / 1'000'000;
+    }
+
+    long on_arrival(long available)
+    {
+        record_idle_period(rdtsc() - idle_start_);
+        idle_start_ = 0;
+        return available;
+    }
+
+    const uint64_t max_spin_cycles_;
+    const uint64_t min_spin_cycles_;
+    const double spin_factor_;
+    const int yield_iterations_;
+
+    uint64_t idle_start_ = 0;
+    double average_gap_cycles_ = 0.0;
+    std::atomic<uint64_t> spin_budget_cycles_;
+};
@@ -1,97 +1,479 @@
 #include <iostream>
-#include <sys/time.h>  // 用于gettimeofday()
-#include <x86intrin.h> // 用于__rdtsc()指令
-#include <unistd.h>    // 用于usleep()
 #include <benchmark/benchmark.h> // Google Benchmark框架
+#include "coroutine.h"
 #include "disruptor.h"
+#include "logger.h"
+#include "order_book/itch_replay.h"
+#include "order_book/order_book_pipeline.h"
+#include "perf_counters.h"
+#include "pipeline.h"
+#include "tsc.h"
+#include "sharded_disruptor.h"
+#include "yield_wait_strategy.h"
+#include <absl/strings/str_format.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <cmath>
+#include <random>
 
-// rdtsc() 函数
+constexpr long kRingSize = 1024;
+
+// Consumer side of the barrier, before and after batching
 /*
-    -   使用__rdtsc()内建函数读取时间戳计数器(TSC)
-    -   返回自CPU启动以来的时钟周期数
-    -   提供高精度的计时
+    -   PerEvent: what EventProcessor::run() used to do. The cursor is loaded
+        once per event and the consumer's own sequence is stored (seq_cst)
+        once per event, so both cache lines ping-pong between the producer's
+        and the consumer's core on every event.
+
+    -   Batched: load the cursor once, drain everything up to it, then hand
+        the whole batch back to the producer with one release store.
 */
-uint64_t rdtsc() { return __rdtsc(); }
+struct PerEventConsumer
+{
+    static long consume(const Sequencer& sequencer, std::atomic<long>& sequence, long last_sequence)
+    {
+        long sum = 0;
+        long next_sequence = 0;
+        while (next_sequence <= last_sequence)
+        {
+            if (next_sequence > sequencer.cursor())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            sum += next_sequence;
+            sequence.store(next_sequence, std::memory_order_seq_cst);
+            ++next_sequence;
+        }
+        return sum;
+    }
+};
 
-/*
-    tsc_in_milli = 1000.0 * (平均结束周期 - 平均开始周期) / 实际时间差(微秒)
+struct BatchedConsumer
+{
+    static long consume(const Sequencer& sequencer, std::atomic<long>& sequence, long last_sequence)
+    {
+        long sum = 0;
+        long next_sequence = 0;
+        while (next_sequence <= last_sequence)
+        {
+            const long available_sequence = sequencer.cursor();
+            if (available_sequence < next_sequence)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (; next_sequence <= available_sequence; ++next_sequence)
+            {
+                sum += next_sequence;
+            }
+            sequence.store(available_sequence, std::memory_order_release);
+        }
+        return sum;
+    }
+};
 
-    其中tsc指的是Time Stamp Counter
+void report_perf_counters(benchmark::State& state, const PerfCounters& counters, double events)
+{
+    if (!counters.available())
+    {
+        state.SetLabel("perf counters unavailable");
+        return;
+    }
 
-    这行代码是计算每毫秒的时钟周期数(cycles per millisecond) 的核心
-    公式。让我详细分解：
+    for (int i = 0; i < PerfCounters::kNumCounters; ++i)
+    {
+        auto counter = static_cast<PerfCounters::Counter>(i);
+        if (counters.available(counter))
+        {
+            state.counters[std::string(PerfCounters::kNames[i]) + "/event"] = counters.value(counter) / events;
+        }
+    }
+}
 
-    -   公式结构
+template <typename Consumer>
+static void BM_ConsumerBarrier(benchmark::State& state)
+{
+    const long events = state.range(0);
+    PerfCounters counters;
 
-        tsc_in_milli = 1000.0 * (平均结束周期 - 平均开始周期) / 实际时间差(微秒)
+    for (auto _ : state)
+    {
+        Sequencer sequencer(kRingSize);
+        Sequence consumer_sequence;
+        sequencer.add_gating_sequence(&consumer_sequence.value);
 
-    -   详细分解:
+        counters.start();
+        std::thread consumer([&]() {
+            benchmark::DoNotOptimize(Consumer::consume(sequencer, consumer_sequence.value, events - 1));
+        });
 
-        1.  分子部分：((ccend1 + ccend0) / 2 - (ccstart1 + ccstart0) / 2)
+        for (long i = 0; i < events; ++i)
+        {
+            long sequence = sequencer.next();
+            sequencer.publish(sequence);
+        }
 
-            平均结束周期 = (ccend1 + ccend0) / 2
-            平均开始周期 = (ccstart1 + ccstart0) / 2
-            周期差 = 平均结束周期 - 平均开始周期
+        consumer.join();
+        counters.stop();
+    }
 
-            -   为什么要取平均值?
+    state.SetItemsProcessed(state.iterations() * events);
+    report_perf_counters(state, counters, static_cast<double>(state.iterations() * events));
+}
+BENCHMARK_TEMPLATE(BM_ConsumerBarrier, PerEventConsumer)->Arg(1 << 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ConsumerBarrier, BatchedConsumer)->Arg(1 << 16)->UseRealTime();
 
-                -   ccstart0: 在gettimeofday()之前的周期数
-                -   ccstart1: 在gettimeofday()之后的周期数
-                -   取平均值是为了减少gettimeofday()函数调用本身的开销影响
-        
-        2.  ((todend.tv_sec - todstart.tv_sec) * 1000000UL + todend.tv_usec - todstart.tv_usec)
+// Publisher cost of a blocking ring with nobody parked: the futex strategy
+// adds a fence and one relaxed load of the waiter count per publish
+template <bool kBlocking>
+static void BM_Publish(benchmark::State& state)
+{
+    Sequencer sequencer;
+    if (kBlocking)
+    {
+        sequencer.enable_blocking_wait();
+    }
 
-            时间差(微秒) = (结束秒数 - 开始秒数) * 1,000,000 + (结束微秒数 - 开始微秒数)
+    for (auto _ : state)
+    {
+        long sequence = sequencer.next();
+        sequencer.publish(sequence);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Publish, false);
+BENCHMARK_TEMPLATE(BM_Publish, true);
 
-        3.  乘以1000.0:
+// Keys drawn from a Zipf(s) distribution over [0, num_keys): a handful of hot
+// instruments and a long tail, which is what a real feed looks like.
+std::vector<uint64_t> zipf_keys(size_t count, size_t num_keys, double s, uint32_t seed = 42)
+{
+    std::vector<double> cdf(num_keys);
+    double sum = 0.0;
+    for (size_t k = 0; k < num_keys; ++k)
+    {
+        sum += 1.0 / std::pow(static_cast<double>(k + 1), s);
+        cdf[k] = sum;
+    }
 
-            每微秒周期数 = 总周期数 / 总时间(微秒)
-            每毫秒周期数 = 每微秒周期数 × 1000 = (总周期数 / 总时间微秒) × 1000            
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, sum);
+    std::vector<uint64_t> keys(count);
+    for (auto& key : keys)
+    {
+        key = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+    }
+    return keys;
+}
 
-            -   因为分母是微妙, 乘以1000转换为周期数/毫秒
-            -   最终得到：周期数/毫秒
-*/
-inline uint64_t tsc_per_milli(bool force = false)
+// Stands in for real per-event work, so that shards have something to scale
+class SpinHandler : public EventHandler
+{
+public:
+    void on_event(Event& event, long sequence, bool) override
+    {
+        uint64_t x = static_cast<uint64_t>(sequence) + event.get().size();
+        for (int i = 0; i < 100; ++i)
+        {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+        benchmark::DoNotOptimize(x);
+    }
+};
+
+static void BM_ShardedDisruptor_Zipf(benchmark::State& state)
 {
-    static uint64_t tsc_in_milli{0}; // 静态变量，只计算一次
+    const size_t num_shards = state.range(0);
+    const size_t events = 1 << 16;
+    const std::vector<uint64_t> keys = zipf_keys(events, 1000, 1.0);
+    const std::string data = "tick";
+
+    std::vector<SpinHandler> handlers(num_shards);
+    std::vector<EventHandler*> handler_ptrs;
+    for (auto& handler : handlers)
+    {
+        handler_ptrs.push_back(&handler);
+    }
 
-    if (tsc_in_milli && !force) return tsc_in_milli;
+    ShardedDisruptor<kRingSize, YieldWaitStrategy> disruptor(handler_ptrs);
+    disruptor.start();
 
-    // 测量开始和结束的时间戳
-    uint64_t ccstart0, ccstart1, ccend0, ccend1;
-    timeval  todstart{}, todend{};
+    long max_depth = 0;
+    for (auto _ : state)
+    {
+        for (uint64_t key : keys)
+        {
+            disruptor.publish(key, data);
+        }
 
-    // 获取时间戳和系统时间的配对测量
-    ccstart0 = rdtsc();
-    gettimeofday(&todstart, nullptr);
-    ccstart1 = rdtsc();
-    usleep(10000);  // sleep for 10 milli seconds or 10000 micro seconds
-    ccend0 = rdtsc();
-    gettimeofday(&todend, nullptr);
-    ccend1 = rdtsc();
+        // Drain, so every iteration measures handled rather than queued events
+        long depth;
+        while ((depth = disruptor.stats().max_depth) != 0)
+        {
+            max_depth = std::max(max_depth, depth);
+        }
+    }
 
-    // 计算平均时钟周期和实际时间差
-    tsc_in_milli = 1000.0 * ((ccend1 + ccend0) / 2 - (ccstart1 + ccstart0) / 2) /
-                   ((todend.tv_sec - todstart.tv_sec) * 1000000UL + todend.tv_usec - todstart.tv_usec);
-    return tsc_in_milli;
+    auto stats = disruptor.stats();
+    disruptor.halt();
+
+    state.SetItemsProcessed(state.iterations() * events);
+    state.counters["skew"] = stats.skew;
+    state.counters["max_depth"] = max_depth;
 }
+BENCHMARK(BM_ShardedDisruptor_Zipf)->DenseRange(1, 8)->UseRealTime();
 
-// tsc_to_nano() 函数
-/*
+// Cost of handing one event to a consumer, on one thread: a virtual
+// EventHandler call against resuming a coroutine suspended in co_await
+class SumHandler : public EventHandler
+{
+public:
+    void on_event(Event&, long sequence, bool) override
+    {
+        sum_ += sequence;
+    }
 
--   将时钟周期差转换为纳秒时间
--   使用之前计算的每毫秒时钟周期数进行转换
+    long sum_ = 0;
+};
 
-*/
+static void BM_DeliverEvent_Callback(benchmark::State& state)
+{
+    Sequencer sequencer;
+    RingBuffer<kRingSize> ring_buffer;
+    SumHandler handler;
+    EventHandler* handler_ptr = &handler;
+    benchmark::DoNotOptimize(handler_ptr);
 
-inline double tsc_to_nano(uint64_t tsc_diff) 
-{ 
-    return (1.0 * tsc_diff / tsc_per_milli()) * 1'000'000;
+    for (auto _ : state)
+    {
+        long sequence = sequencer.next();
+        sequencer.publish(sequence);
+        handler_ptr->on_event(ring_buffer.get(sequence), sequence, true);
+    }
+    benchmark::DoNotOptimize(handler.sum_);
+    state.SetItemsProcessed(state.iterations());
 }
+BENCHMARK(BM_DeliverEvent_Callback);
 
-template<typename Queue>
-uint64_t bm_
+Task sum_events(Scheduler& scheduler, const Sequencer& sequencer, long& sum)
+{
+    for (long next_sequence = 0;; ++next_sequence)
+    {
+        co_await scheduler.wait_for(sequencer, next_sequence);
+        sum += next_sequence;
+    }
+}
 
+static void BM_DeliverEvent_Coroutine(benchmark::State& state)
+{
+    Sequencer sequencer;
+    Scheduler scheduler;
+    long sum = 0;
+    scheduler.spawn(sum_events(scheduler, sequencer, sum));
 
+    for (auto _ : state)
+    {
+        long sequence = sequencer.next();
+        sequencer.publish(sequence);
+        scheduler.poll();
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DeliverEvent_Coroutine);
 
+// The same diamond, A -> (B, C) -> D, built at runtime from EventProcessors
+// with virtual handlers and built as a type with Pipeline. Every iteration
+// publishes a burst and waits for D to finish it.
+struct StaticSumHandler
+{
+    void on_event(Event&, long sequence, bool)
+    {
+        sum_ += sequence;
+    }
+
+    long sum_ = 0;
+};
+
+static void BM_Diamond_Runtime(benchmark::State& state)
+{
+    const long burst = state.range(0);
+    auto ring_buffer = std::make_shared<RingBuffer<kRingSize>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    SumHandler handlers[4];
+    EventProcessor<kRingSize> a(ring_buffer, sequencer, 0, &handlers[0]);
+    EventProcessor<kRingSize> b(ring_buffer, sequencer, 1, &handlers[1]);
+    EventProcessor<kRingSize> c(ring_buffer, sequencer, 2, &handlers[2]);
+    EventProcessor<kRingSize> d(ring_buffer, sequencer, 3, &handlers[3]);
+    b.add_dependency(a);
+    c.add_dependency(a);
+    d.add_dependency(b);
+    d.add_dependency(c);
+
+    Producer<kRingSize> producer(ring_buffer, sequencer);
+    std::vector<EventProcessor<kRingSize>*> processors = {&a, &b, &c, &d};
+    std::vector<Producer<kRingSize>*> producers = {&producer};
+    Disruptor<kRingSize, YieldWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    long last = -1;
+    for (auto _ : state)
+    {
+        for (long i = 0; i < burst; ++i)
+        {
+            last = producer.publish("event");
+        }
+        while (d.sequence().load(std::memory_order_acquire) != last)
+        {
+            std::this_thread::yield();
+        }
+    }
+    disruptor.halt();
+
+    benchmark::DoNotOptimize(handlers[3].sum_);
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_Diamond_Runtime)->Arg(1 << 12)->UseRealTime();
+
+static void BM_Diamond_Static(benchmark::State& state)
+{
+    const long burst = state.range(0);
+    auto pipeline = std::make_unique<Pipeline<Event, kRingSize, YieldWaitStrategy,
+        Stage<StaticSumHandler>, Parallel<StaticSumHandler, StaticSumHandler>, Stage<StaticSumHandler>>>();
+    pipeline->start();
+
+    long last = -1;
+    for (auto _ : state)
+    {
+        for (long i = 0; i < burst; ++i)
+        {
+            last = pipeline->next();
+            pipeline->get(last).set("event");
+            pipeline->publish(last);
+        }
+        while (pipeline->sequence<2>().load(std::memory_order_acquire) != last)
+        {
+            std::this_thread::yield();
+        }
+    }
+    pipeline->halt();
+
+    benchmark::DoNotOptimize(pipeline->handler<2>().sum_);
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_Diamond_Static)->Arg(1 << 12)->UseRealTime();
+
+// Market data load: an ITCH capture replayed into the order book pipeline.
+// Set ITCH_CAPTURE to replay a real capture; otherwise a synthetic one is
+// recorded once into /tmp.
+static const std::string& itch_capture_path()
+{
+    static const std::string path = []() {
+        if (const char* capture = std::getenv("ITCH_CAPTURE"))
+        {
+            return std::string(capture);
+        }
+        std::string synthetic = "/tmp/bm_disruptor_synthetic.itch";
+        record_synthetic_capture(synthetic, 1 << 18);
+        return synthetic;
+    }();
+    return path;
+}
+
+// One iteration replays the first `messages` messages of the capture into
+// a fresh pipeline, so the book always starts empty. Recorded mode keeps
+// the capture's gaps divided by `speed`: a real capture spans a whole
+// session, so both bound how long an iteration takes.
+template <ReplayMode kMode>
+static void BM_ItchReplay(benchmark::State& state)
+{
+    ItchCapture capture(itch_capture_path());
+    const double speed = static_cast<double>(state.range(0));
+    const size_t max_messages = static_cast<size_t>(state.range(1));
+    size_t messages = 0;
+    double p50 = 0, p99 = 0, p999 = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        ItchParser parser(capture);
+        auto pipeline = std::make_unique<OrderBookPipeline<kRingSize>>();
+        pipeline->start();
+        state.ResumeTiming();
+
+        const long sequence = replay(*pipeline, parser, kMode, speed, max_messages);
+        while (pipeline->sequence<1>().load(std::memory_order_acquire) != sequence)
+        {
+            std::this_thread::yield();
+        }
+
+        state.PauseTiming();
+        pipeline->halt();
+        messages += parser.decoded();
+        LatencyRecorder& latencies = pipeline->handler<1>().latencies();
+        p50 = latencies.percentile_ns(50);
+        p99 = latencies.percentile_ns(99);
+        p999 = latencies.percentile_ns(99.9);
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(messages);
+    state.counters["p50_ns"] = p50;
+    state.counters["p99_ns"] = p99;
+    state.counters["p99.9_ns"] = p999;
+}
+BENCHMARK_TEMPLATE(BM_ItchReplay, ReplayMode::FlatOut)->ArgNames({"speed", "messages"})
+    ->Args({1, 1 << 18})->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ItchReplay, ReplayMode::Recorded)->ArgNames({"speed", "messages"})
+    ->Args({1, 1 << 16})->Args({10, 1 << 18})->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Cost to the calling thread of logging one line: an order fill with an
+// id, a quantity, a price and a symbol. Every logger writes to /dev/null.
+static void BM_Log_Ostream(benchmark::State& state)
+{
+    std::ofstream out("/dev/null");
+    const std::string symbol = "AAPL";
+    long id = 0;
+    for (auto _ : state)
+    {
+        out << "order " << ++id << " filled " << 100 << " @ " << 187.25 << " on " << symbol << std::endl;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Log_Ostream);
+
+static void BM_Log_StrFormat(benchmark::State& state)
+{
+    const int fd = ::open("/dev/null", O_WRONLY);
+    const std::string symbol = "AAPL";
+    long id = 0;
+    for (auto _ : state)
+    {
+        const std::string line = absl::StrFormat("order %d filled %d @ %g on %s\n", ++id, 100, 187.25, symbol);
+        benchmark::DoNotOptimize(::write(fd, line.data(), line.size()));
+    }
+    ::close(fd);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Log_StrFormat);
+
+static void BM_Log_Async(benchmark::State& state)
+{
+    std::ofstream out("/dev/null");
+    Logger logger(out);
+    logger.start();
+    const std::string symbol = "AAPL";
+    long id = 0;
+    for (auto _ : state)
+    {
+        logger.log("order {} filled {} @ {} on {}", ++id, 100, 187.25, symbol);
+    }
+    logger.stop();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Log_Async);
 
+BENCHMARK_MAIN();
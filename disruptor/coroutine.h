@@ -0,0 +1,200 @@
+#pragma once
+
+#include "sequencer.h"
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <vector>
+
+// C++20 coroutine consumers
+/*
+    -   A consumer is written as a coroutine returning Task. Instead of a
+        callback per event it co_awaits the sequence it needs next:
+
+            long available = co_await scheduler.wait_for(sequencer, next);
+
+        and resumes with everything published up to `available`, so it can
+        still drain a whole batch per wake-up.
+
+    -   Scheduler is single threaded: run() polls every suspended
+        coroutine's sequencer and resumes the ones whose sequence has been
+        published. One pinned thread per core can drive any number of
+        multi-step consumers (e.g. waiting for a request on one ring, then
+        for its response on another) written as straight-line code.
+
+    -   Nothing here publishes a consumer sequence: a coroutine that gates a
+        producer stores its own Sequence, as EventProcessor does.
+*/
+class Task
+{
+public:
+    struct promise_type
+    {
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        // Started by Scheduler::spawn(), destroyed as soon as it returns
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task&& other) noexcept : handle_(other.handle_)
+    {
+        other.handle_ = nullptr;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    // A task that was never spawned is destroyed with it
+    ~Task()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+private:
+    friend class Scheduler;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> release()
+    {
+        auto handle = handle_;
+        handle_ = nullptr;
+        return handle;
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+class Scheduler
+{
+public:
+    class SequenceAwaitable
+    {
+    public:
+        SequenceAwaitable(Scheduler& scheduler, const Sequencer& sequencer, long sequence)
+            : scheduler_(scheduler), sequencer_(sequencer), sequence_(sequence)
+        {
+        }
+
+        // Already published: carry on without suspending
+        bool await_ready()
+        {
+            available_ = sequencer_.cursor();
+            return available_ >= sequence_;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            scheduler_.waiters_.push_back(Waiter{&sequencer_, sequence_, &available_, handle});
+        }
+
+        long await_resume() const
+        {
+            return available_;
+        }
+
+    private:
+        Scheduler& scheduler_;
+        const Sequencer& sequencer_;
+        long sequence_;
+        long available_ = -1;
+    };
+
+    Scheduler() = default;
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // Coroutines still suspended are destroyed with the scheduler
+    ~Scheduler()
+    {
+        for (Waiter& waiter : waiters_)
+        {
+            waiter.handle.destroy();
+        }
+    }
+
+    // Suspend until sequencer's cursor reaches sequence; resumes with the cursor
+    SequenceAwaitable wait_for(const Sequencer& sequencer, long sequence)
+    {
+        return SequenceAwaitable(*this, sequencer, sequence);
+    }
+
+    // Run the task up to its first co_await that has to wait
+    void spawn(Task task)
+    {
+        task.release().resume();
+    }
+
+    // One pass over every suspended coroutine. Returns how many were resumed.
+    size_t poll()
+    {
+        // Collect first: a resumed coroutine may suspend again and append to
+        // waiters_ while we would still be iterating it
+        ready_.clear();
+        for (size_t i = 0; i < waiters_.size();)
+        {
+            Waiter& waiter = waiters_[i];
+            long available = waiter.sequencer->cursor();
+            if (available >= waiter.sequence)
+            {
+                *waiter.available = available;
+                ready_.push_back(waiter.handle);
+                waiter = waiters_.back();
+                waiters_.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        for (std::coroutine_handle<> handle : ready_)
+        {
+            handle.resume();
+        }
+        return ready_.size();
+    }
+
+    // Poll until stop() is called or every task has returned
+    void run()
+    {
+        running_.store(true, std::memory_order_relaxed);
+        while (running_.load(std::memory_order_relaxed) && !waiters_.empty())
+        {
+            poll();
+        }
+    }
+
+    void stop()
+    {
+        running_.store(false, std::memory_order_relaxed);
+    }
+
+    size_t suspended() const
+    {
+        return waiters_.size();
+    }
+
+private:
+    struct Waiter
+    {
+        const Sequencer* sequencer;
+        long sequence;
+        long* available;
+        std::coroutine_handle<> handle;
+    };
+
+    std::vector<Waiter> waiters_;
+    std::vector<std::coroutine_handle<>> ready_;
+    std::atomic<bool> running_{false};
+};
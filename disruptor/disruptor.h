@@ -4,6 +4,7 @@
 #include "event_processor.h"
 #include "producer.h"
 #include "wait_strategy.h"
+#include <algorithm>
 #include <vector>
 #include <thread>
 
@@ -11,13 +12,19 @@ template <size_t N, typename WaitStrategyDerived>
 class Disruptor
 {
 public:
-    explicit Disruptor(std::vector<EventProcessor<N>*>& processors, std::vector<Producer<N>*>& producers)
-        : sequencer_(std::make_shared<Sequencer>()), processors_(processors), 
+    explicit Disruptor(std::vector<EventProcessor<N, WaitStrategyDerived>*>& processors, std::vector<Producer<N>*>& producers)
+        : sequencer_(std::make_shared<Sequencer>(N)), processors_(processors), 
         producers_(producers), buffer_(std::make_shared<RingBuffer<N>>())
     {
-        for (EventProcessor<N>* processor : processors_)
+        if constexpr (WaitStrategyDerived::kBlocking)
+        {
+            sequencer_->enable_blocking_wait();
+        }
+
+        for (EventProcessor<N, WaitStrategyDerived>* processor : processors_)
         {
             processor->set_sequencer(sequencer_);
+            sequencer_->add_gating_sequence(&processor->sequence());
         }
 
         for (Producer<N>* producer : producers_) {
@@ -29,17 +36,63 @@ public:
 
     void start()
     {
-        for (EventProcessor<N>* processor : processors_) {
+        for (EventProcessor<N, WaitStrategyDerived>* processor : processors_) {
+            processor->resume();
+            threads_.emplace_back([processor]() { processor->run(); });
+        }
+        started_ = true;
+    }
+
+    // Add a consumer while the ring is running, e.g. a debug tap or late
+    // joining analytics. It sees events published after the call returns.
+    // The producer is never paused: it picks the new gating set up the next
+    // time it checks for wrap-around.
+    void attach(EventProcessor<N, WaitStrategyDerived>* processor)
+    {
+        processor->set_sequencer(sequencer_);
+        sequencer_->add_gating_sequence(&processor->sequence());
+        processors_.push_back(processor);
+
+        if (started_) {
+            // A processor detached earlier is still halted
+            processor->resume();
             threads_.emplace_back([processor]() { processor->run(); });
         }
     }
 
+    // Stop and remove a consumer; the producer no longer waits for it.
+    // Returns false if the processor is not part of this Disruptor.
+    bool detach(EventProcessor<N, WaitStrategyDerived>* processor)
+    {
+        auto it = std::find(processors_.begin(), processors_.end(), processor);
+        if (it == processors_.end()) {
+            return false;
+        }
+
+        // Stop it before it stops gating, so it never reads a slot the
+        // producer is overwriting
+        if (started_) {
+            processor->halt();
+            sequencer_->wake_waiters();
+            std::thread& thread = threads_[it - processors_.begin()];
+            if (thread.joinable()) {
+                thread.join();
+            }
+            threads_.erase(threads_.begin() + (it - processors_.begin()));
+        }
+
+        sequencer_->remove_gating_sequence(&processor->sequence());
+        processors_.erase(it);
+        return true;
+    }
+
     void halt()
     {
         // 1. Notify all processors to stop
-        for (EventProcessor<N>* processor : processors_) {
+        for (EventProcessor<N, WaitStrategyDerived>* processor : processors_) {
             processor->halt();
         }
+        sequencer_->wake_waiters();
 
         // 2. Wait for all threads to finish normally
         for (auto& t : threads_) {
@@ -50,6 +103,7 @@ public:
 
         // 3. Clear the thread array
         threads_.clear();
+        started_ = false;
     }
 
     long cursor() const
@@ -57,11 +111,52 @@ public:
         return sequencer_->cursor();
     }
 
+    // Counters of the ring and of every processor. Meant for a monitoring
+    // thread; it only reads, so the ring's threads never notice. Like
+    // attach() and detach() it walks the processor list, so it must not run
+    // concurrently with them.
+    RingSnapshot snapshot() const
+    {
+        RingSnapshot snapshot;
+        snapshot.cursor = sequencer_->cursor();
+        snapshot.producer_stalls = sequencer_->metrics().stalls.load();
+        snapshot.producer_stall_cycles = sequencer_->metrics().stall_cycles.load();
+        snapshot.producer_truncations = sequencer_->metrics().truncations.load();
+
+        snapshot.processors.reserve(processors_.size());
+        for (const EventProcessor<N, WaitStrategyDerived>* processor : processors_)
+        {
+            const ProcessorMetrics& metrics = processor->metrics();
+
+            ProcessorSnapshot processor_snapshot;
+            processor_snapshot.id = processor->id();
+            processor_snapshot.sequence = processor->sequence().load(std::memory_order_acquire);
+            processor_snapshot.lag = snapshot.cursor - processor_snapshot.sequence;
+            processor_snapshot.events = metrics.events.load();
+            processor_snapshot.batches = metrics.batches.load();
+            processor_snapshot.idle_spins = metrics.idle_spins.load();
+            for (size_t i = 0; i < kBatchSizeBuckets; ++i)
+            {
+                processor_snapshot.batch_sizes[i] = metrics.batch_sizes[i].load();
+            }
+            processor_snapshot.handler_cycles = metrics.handler_cycles.load();
+            processor_snapshot.waiting_cycles = metrics.waiting_cycles.load();
+            processor_snapshot.wait_strategy_cycles = metrics.wait_strategy_cycles.load();
+            processor_snapshot.spin_budget_cycles = 0;
+            if constexpr (requires { processor->wait_strategy().spin_budget_cycles(); })
+            {
+                processor_snapshot.spin_budget_cycles = processor->wait_strategy().spin_budget_cycles();
+            }
+            snapshot.processors.push_back(processor_snapshot);
+        }
+        return snapshot;
+    }
+
 private:
     std::shared_ptr<Sequencer> sequencer_;  // Changed from Sequencer to std::shared_ptr<Sequencer>
-    std::vector<EventProcessor<N>*> processors_;
+    std::vector<EventProcessor<N, WaitStrategyDerived>*> processors_;
     std::vector<Producer<N>*> producers_;
-    WaitStrategy<WaitStrategyDerived>* wait_strategy_;
     std::shared_ptr<RingBuffer<N>> buffer_;
-    std::vector<std::thread> threads_;
+    std::vector<std::thread> threads_;  // threads_[i] runs processors_[i] once started
+    bool started_ = false;
 };
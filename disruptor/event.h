@@ -1,22 +1,43 @@
 #pragma once
 
-#include <string>
+#include "fixed_string.h"
+#include "object_pool.h"
+#include <string_view>
+
+// Longest payload an Event carries inline; longer ones are truncated, and
+// counted in ProducerMetrics::truncations. Larger payloads go through an
+// ObjectPool.
+constexpr size_t kEventValueCapacity = 55;
 
 class Event
 {
 public:
     Event() = default;
     
-    void set(const std::string& value)
+    // false if value was longer than kEventValueCapacity and got truncated
+    bool set(std::string_view value)
+    {
+        return value_.assign(value);
+    }
+
+    // Valid until the producer claims this slot again
+    std::string_view get() const
+    {
+        return value_.view();
+    }
+
+    // Set instead of the value when the payload lives in an ObjectPool
+    void set_handle(PoolHandle handle)
     {
-        value_ = value;
+        handle_ = handle;
     }
 
-    std::string get() const
+    PoolHandle handle() const
     {
-        return value_;
+        return handle_;
     }
 
 private:
-    std::string value_;
+    FixedString<kEventValueCapacity> value_;
+    PoolHandle handle_ = kNoPoolHandle;
 };
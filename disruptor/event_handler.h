@@ -0,0 +1,33 @@
+#pragma once
+
+#include "event.h"
+#include "logger.h"
+
+// Callback an EventProcessor invokes for every event it consumes.
+/*
+    end_of_batch is true for the last event of the batch the processor read
+    from the cursor, so handlers can defer flushing or publishing downstream
+    until then.
+*/
+class EventHandler
+{
+public:
+    virtual ~EventHandler() = default;
+    virtual void on_event(Event& event, long sequence, bool end_of_batch) = 0;
+};
+
+// The default handler: print every event consumed, through the
+// asynchronous default_logger() so the consumer never waits on stdout.
+class PrintEventHandler : public EventHandler
+{
+public:
+    explicit PrintEventHandler(int id) : id_(id) {}
+
+    void on_event(Event& event, long sequence, bool) override
+    {
+        default_logger().log("[Consumer {} ] Consumed: {} from sequence: {}", id_, event.get(), sequence);
+    }
+
+private:
+    int id_;
+};
@@ -2,30 +2,87 @@
 
 #include "sequencer.h"
 #include "ring_buffer.h"
+#include "event_handler.h"
+#include "tracer.h"
+#include "yield_wait_strategy.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
-template <size_t N>
+template <size_t N, typename WaitStrategyDerived = YieldWaitStrategy>
 class EventProcessor
 {
 public:
-    EventProcessor(std::shared_ptr<RingBuffer<N>> ring_buffer, std::shared_ptr<Sequencer> sequencer, int id)
-        : running_(true), next_sequence_(0), ring_buffer_(ring_buffer), sequencer_(sequencer), id_(id)
+    // Without a handler every event is printed.
+    EventProcessor(std::shared_ptr<RingBuffer<N>> ring_buffer, std::shared_ptr<Sequencer> sequencer, int id,
+                   EventHandler* handler = nullptr)
+        : running_(true), ring_buffer_(ring_buffer), sequencer_(sequencer), id_(id),
+        print_handler_(id), handler_(handler ? handler : &print_handler_)
     {
         std::cout << "EventProcessor Sequencer Addr: " << sequencer_.get() << std::endl;
     }
 
     void run()
     {
+        // Hoist the shared_ptr indirections out of the loop
+        Sequencer* sequencer = sequencer_.get();
+        RingBuffer<N>* ring_buffer = ring_buffer_.get();
+        EventHandler* handler = handler_;
+        const TraceSampler sampler = trace_headers_ ? trace_headers_->sampler() : TraceSampler();
+        const std::vector<const std::atomic<long>*> dependencies = dependencies_;
+        long next_sequence = sequence_.value.load(std::memory_order_relaxed) + 1;
+
+        // Every cycle since `charged` is charged to exactly one of handler,
+        // waiting or wait strategy time
+        uint64_t charged = rdtsc();
+
+        // Read the cursor once per batch instead of once per event: every
+        // load of the cursor's cache line may miss while the producer
+        // keeps writing it.
+        auto barrier = [sequencer, &dependencies]() {
+            long available = sequencer->cursor();
+            for (const std::atomic<long>* dependency : dependencies)
+            {
+                available = std::min(available, dependency->load(std::memory_order_acquire));
+            }
+            return available;
+        };
+
         //std::cout << "Consumer running. Waiting for events...\n";
-        while (running_)
+        while (running_.load(std::memory_order_relaxed))
         {
-            //std::cout << "Consumer is in the while loop. Next sequence to read: " << nextSequence_ << "\n";
-            while (next_sequence_ <= sequencer_->cursor())
+            const long available_sequence = barrier();
+            if (available_sequence < next_sequence)
             {
-                Event& event = ring_buffer_->get(next_sequence_);
-                std::cout << "[Consumer " << id_ << " ]" << " Consumed: " << event.get() << " from sequence: " << next_sequence_ << "\n";
-                ++next_sequence_;
+                metrics_.idle_spins.add();
+                const uint64_t wait_start = rdtsc();
+                metrics_.waiting_cycles.add(wait_start - charged);
+                wait_strategy_.wait_for(next_sequence, *sequencer, running_, barrier);
+                charged = rdtsc();
+                metrics_.wait_strategy_cycles.add(charged - wait_start);
+                continue;
             }
+
+            const uint64_t batch_start = rdtsc();
+            metrics_.waiting_cycles.add(batch_start - charged);
+            metrics_.on_batch(available_sequence - next_sequence + 1);
+
+            for (; next_sequence <= available_sequence; ++next_sequence)
+            {
+                Event& event = ring_buffer->get(next_sequence);
+                if (sampler.sampled(next_sequence)) [[unlikely]]
+                {
+                    traced_on_event(handler, event, next_sequence, next_sequence == available_sequence);
+                    continue;
+                }
+                handler->on_event(event, next_sequence, next_sequence == available_sequence);
+            }
+
+            // A single release store hands the whole batch back to the producer
+            sequence_.value.store(available_sequence, std::memory_order_release);
+            charged = rdtsc();
+            metrics_.handler_cycles.add(charged - batch_start);
         }
     }
 
@@ -36,7 +93,14 @@ public:
 
     void halt()
     {
-        running_ = false;
+        running_.store(false, std::memory_order_relaxed);
+    }
+
+    // Undo halt() so that run() can be started again, e.g. on a processor
+    // that was detached and is attached again. Not while it runs.
+    void resume()
+    {
+        running_.store(true, std::memory_order_relaxed);
     }
 
     // If you want to be able to set the Sequencer dynamically
@@ -45,10 +109,81 @@ public:
         sequencer_ = sequencer;
     }
 
+    // Only consume events upstream has finished with, e.g. a journaller
+    // before a business logic processor. Call before the processor runs.
+    void add_dependency(const EventProcessor& upstream)
+    {
+        dependencies_.push_back(&upstream.sequence());
+    }
+
+    // Stamp enter/exit TSC of sampled sequences into headers as stage
+    // `stage` and push them to sink. Call before the processor runs.
+    void enable_tracing(TraceHeaders& headers, int stage, TraceSink& sink)
+    {
+        if (stage < 0 || static_cast<size_t>(stage) >= kMaxTraceStages)
+        {
+            throw std::out_of_range("EventProcessor: trace stage out of range");
+        }
+        trace_headers_ = &headers;
+        trace_stage_ = stage;
+        trace_sink_ = &sink;
+    }
+
+    WaitStrategyDerived& wait_strategy()
+    {
+        return wait_strategy_;
+    }
+
+    const WaitStrategyDerived& wait_strategy() const
+    {
+        return wait_strategy_;
+    }
+
+    int id() const
+    {
+        return id_;
+    }
+
+    const ProcessorMetrics& metrics() const
+    {
+        return metrics_;
+    }
+
+    // The last sequence this processor has finished with; producers gate on it.
+    std::atomic<long>& sequence()
+    {
+        return sequence_.value;
+    }
+
+    const std::atomic<long>& sequence() const
+    {
+        return sequence_.value;
+    }
+
 private:
-    bool running_;
-    long next_sequence_;
+    __attribute__((noinline))
+    void traced_on_event(EventHandler* handler, Event& event, long sequence, bool end_of_batch)
+    {
+        TraceHeader& header = (*trace_headers_)[sequence];
+        TraceHeader::Stage& stamps = header.stages[trace_stage_];
+        stamps.enter_tsc = rdtsc();
+        handler->on_event(event, sequence, end_of_batch);
+        stamps.exit_tsc = rdtsc();
+
+        trace_sink_->push(TraceRecord{sequence, trace_stage_, header.publish_tsc, stamps});
+    }
+
+    std::atomic<bool> running_;
     std::shared_ptr<RingBuffer<N>> ring_buffer_;
     std::shared_ptr<Sequencer> sequencer_;
     int id_;
-};
\ No newline at end of file
+    PrintEventHandler print_handler_;
+    EventHandler* handler_;
+    WaitStrategyDerived wait_strategy_;
+    std::vector<const std::atomic<long>*> dependencies_;
+    TraceHeaders* trace_headers_ = nullptr;
+    int trace_stage_ = 0;
+    TraceSink* trace_sink_ = nullptr;
+    Sequence sequence_;
+    ProcessorMetrics metrics_;
+};
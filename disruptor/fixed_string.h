@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// A string with inline, fixed capacity storage
+/*
+    -   std::string keeps up to 15 characters inline (libstdc++, see
+        design_patterns/sso/sso.cc); anything longer is a malloc on every
+        copy. FixedString<N> holds up to N characters in place and a length
+        byte, so copying one is a memcpy of sizeof(FixedString<N>) bytes and
+        never allocates.
+
+    -   Assigning a longer string keeps its first N characters: a slot must
+        not allocate on the hot path, so the payload is bounded by design.
+        assign() returns false when it cuts, for the caller to count or
+        reject. Pick N for the longest message the ring carries.
+
+    -   Read through std::string_view; comparison and std::hash go through
+        it as well, so a FixedString hashes like the std::string with the
+        same characters.
+*/
+template <size_t N>
+class FixedString
+{
+    static_assert(N > 0 && N <= UINT8_MAX, "FixedString capacity must fit in its length byte");
+
+public:
+    constexpr FixedString() = default;
+
+    constexpr FixedString(std::string_view value)
+    {
+        assign(value);
+    }
+
+    constexpr FixedString(const char* value) : FixedString(std::string_view(value)) {}
+
+    // false if value was longer than N and got truncated
+    constexpr bool assign(std::string_view value)
+    {
+        size_ = static_cast<uint8_t>(std::min(value.size(), N));
+        std::copy_n(value.data(), size_, data_.data());
+        return value.size() <= N;
+    }
+
+    constexpr std::string_view view() const
+    {
+        return std::string_view(data_.data(), size_);
+    }
+
+    constexpr operator std::string_view() const
+    {
+        return view();
+    }
+
+    constexpr const char* data() const
+    {
+        return data_.data();
+    }
+
+    constexpr size_t size() const
+    {
+        return size_;
+    }
+
+    constexpr bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return N;
+    }
+
+    friend constexpr bool operator==(const FixedString& lhs, const FixedString& rhs)
+    {
+        return lhs.view() == rhs.view();
+    }
+
+    friend constexpr std::strong_ordering operator<=>(const FixedString& lhs, const FixedString& rhs)
+    {
+        return lhs.view() <=> rhs.view();
+    }
+
+private:
+    std::array<char, N> data_{};
+    uint8_t size_ = 0;
+};
+
+template <size_t N>
+struct std::hash<FixedString<N>>
+{
+    size_t operator()(const FixedString<N>& value) const noexcept
+    {
+        return std::hash<std::string_view>{}(value.view());
+    }
+};
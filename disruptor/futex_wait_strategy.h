@@ -0,0 +1,54 @@
+#pragma once
+
+#include "wait_strategy.h"
+#include <immintrin.h>
+
+// Spin, then sleep in the kernel until the producer publishes
+/*
+    -   The consumer polls the cursor spin_iterations times (with pause) so
+        that a busy ring never pays for a syscall, then parks in
+        Sequencer::wait_for_publish(), a futex wait.
+
+    -   The producer only pays for the wake-up when somebody is parked: its
+        publish() checks the waiter count with one relaxed load and skips the
+        futex wake otherwise. Compare a condition variable strategy, which
+        locks a mutex on every publish.
+
+    -   Meant for rings that are not latency critical: an idle consumer uses
+        no CPU, at the cost of a few microseconds to wake it up.
+*/
+class FutexWaitStrategy : public WaitStrategy<FutexWaitStrategy>
+{
+public:
+    static constexpr bool kBlocking = true;
+
+    explicit FutexWaitStrategy(int spin_iterations = 1000) : spin_iterations_(spin_iterations) {}
+
+    void waitImpl()
+    {
+        _mm_pause();
+    }
+
+    long wait_for_impl(long sequence, Sequencer& sequencer, const std::atomic<bool>& running)
+    {
+        long available;
+        for (int i = 0; i < spin_iterations_; ++i)
+        {
+            if ((available = sequencer.cursor()) >= sequence)
+            {
+                return available;
+            }
+            _mm_pause();
+        }
+
+        return sequencer.wait_for_publish(sequence, running);
+    }
+
+    void set_spin_iterations(int spin_iterations)
+    {
+        spin_iterations_ = spin_iterations;
+    }
+
+private:
+    int spin_iterations_;
+};
@@ -1,7 +1,34 @@
+#include "adaptive_wait_strategy.h"
+#include "coroutine.h"
 #include "disruptor.h"
+#include "futex_wait_strategy.h"
+#include "logger.h"
+#include "metrics_reporter.h"
+#include "order_book/itch_replay.h"
+#include "order_book/order_book_pipeline.h"
+#include "pipeline.h"
+#include "sharded_disruptor.h"
 #include "yield_wait_strategy.h"
 
 #include <gtest/gtest.h>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <sstream>
+
+// Every malloc in the test binary is counted, so a test can check a code
+// path does not allocate. glibc >= 2.34 dropped the __malloc_hook that
+// design_patterns/dictionary/ext/mtrace.h relies on, so malloc itself is
+// interposed and forwards to glibc's.
+static std::atomic<size_t> g_malloc_calls{0};
+
+extern "C" void* __libc_malloc(size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    g_malloc_calls.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
 
 /*  
 
@@ -93,6 +120,1248 @@ TEST(DisruptorTest, BasicTest)
     disruptor.halt();
 }
 
+TEST(DisruptorTest, SequencerGatesOnSlowestConsumer)
+{
+    Sequencer sequencer(4);
+    Sequence fast_consumer;
+    Sequence slow_consumer;
+    sequencer.add_gating_sequence(&fast_consumer.value);
+    sequencer.add_gating_sequence(&slow_consumer.value);
+
+    // The first lap of the ring is free
+    for (long i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(sequencer.next(), i);
+        sequencer.publish(i);
+    }
+
+    fast_consumer.value.store(3);
+
+    std::atomic<bool> claimed{false};
+    std::thread producer([&]() {
+        sequencer.next(); // would overwrite sequence 0
+        claimed = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(claimed);
+
+    slow_consumer.value.store(0);
+    producer.join();
+    EXPECT_TRUE(claimed);
+}
+
+TEST(DisruptorTest, ProcessorPublishesSequenceAfterBatch)
+{
+    const size_t N = 8;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N> consumer(ring_buffer, sequencer, 0);
+
+    std::vector<EventProcessor<N>*> processors = {&consumer};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, YieldWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    EXPECT_EQ(consumer.sequence().load(), -1);
+
+    // More than one lap, so the producer has to gate on the consumer
+    for (int i = 0; i < 20; ++i)
+    {
+        producer.on_data("Event " + std::to_string(i));
+    }
+
+    while (consumer.sequence().load() != 19)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(disruptor.cursor(), 19);
+
+    disruptor.halt();
+}
+
+// Records, per key, the order in which a shard handled its events
+class KeyOrderHandler : public EventHandler
+{
+public:
+    void on_event(Event& event, long, bool) override
+    {
+        std::string value(event.get());
+        size_t colon = value.find(':');
+        uint64_t key = std::stoull(value.substr(0, colon));
+        long count = std::stol(value.substr(colon + 1));
+
+        if (last_count_.count(key) && last_count_[key] + 1 != count)
+        {
+            ++out_of_order_;
+        }
+        last_count_[key] = count;
+        ++handled_;
+    }
+
+    std::map<uint64_t, long> last_count_;
+    long handled_ = 0;
+    long out_of_order_ = 0;
+};
+
+TEST(DisruptorTest, ShardedDisruptorPreservesPerKeyOrder)
+{
+    const size_t N = 16;
+    const uint64_t num_keys = 32;
+    const long events_per_key = 100;
+
+    std::vector<KeyOrderHandler> handlers(4);
+    std::vector<EventHandler*> handler_ptrs;
+    for (auto& handler : handlers)
+    {
+        handler_ptrs.push_back(&handler);
+    }
+
+    ShardedDisruptor<N, YieldWaitStrategy> disruptor(handler_ptrs);
+    disruptor.start();
+
+    for (long count = 0; count < events_per_key; ++count)
+    {
+        for (uint64_t key = 0; key < num_keys; ++key)
+        {
+            disruptor.publish(key, std::to_string(key) + ":" + std::to_string(count));
+        }
+    }
+
+    while (disruptor.stats().max_depth != 0)
+    {
+        std::this_thread::yield();
+    }
+    disruptor.halt();
+
+    auto stats = disruptor.stats();
+    ASSERT_EQ(stats.shards.size(), 4u);
+
+    long total = 0;
+    for (size_t shard = 0; shard < handlers.size(); ++shard)
+    {
+        EXPECT_EQ(handlers[shard].out_of_order_, 0);
+        EXPECT_EQ(handlers[shard].handled_, stats.shards[shard].cursor + 1);
+        total += handlers[shard].handled_;
+
+        // Every key is owned by exactly one shard
+        for (const auto& [key, last_count] : handlers[shard].last_count_)
+        {
+            EXPECT_EQ(disruptor.shard_of(key), shard);
+            EXPECT_EQ(last_count, events_per_key - 1);
+        }
+    }
+    EXPECT_EQ(total, static_cast<long>(num_keys) * events_per_key);
+    EXPECT_GE(stats.skew, 1.0);
+}
+
+// Counts the events it sees and remembers the first sequence
+class CountingHandler : public EventHandler
+{
+public:
+    void on_event(Event&, long sequence, bool) override
+    {
+        if (first_sequence_ < 0)
+        {
+            first_sequence_ = sequence;
+        }
+        handled_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    long first_sequence_ = -1;
+    std::atomic<long> handled_{0};
+};
+
+TEST(DisruptorTest, AttachAndDetachWhileRunning)
+{
+    const size_t N = 8;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    CountingHandler main_handler;
+    CountingHandler tap_handler;
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N> consumer(ring_buffer, sequencer, 0, &main_handler);
+    EventProcessor<N> tap(ring_buffer, sequencer, 1, &tap_handler);
+
+    std::vector<EventProcessor<N>*> processors = {&consumer};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, YieldWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    for (int i = 0; i < 10; ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+    }
+
+    // The tap joins at the cursor and only sees what comes after it
+    disruptor.attach(&tap);
+    EXPECT_EQ(tap.sequence().load(), 9);
+
+    for (int i = 10; i < 30; ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+    }
+    while (tap.sequence().load() != 29 || consumer.sequence().load() != 29)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(tap_handler.first_sequence_, 10);
+    EXPECT_EQ(tap_handler.handled_.load(), 20);
+
+    // Once detached the tap no longer gates the producer, which can lap it
+    EXPECT_TRUE(disruptor.detach(&tap));
+    EXPECT_FALSE(disruptor.detach(&tap));
+
+    for (int i = 30; i < 30 + 4 * static_cast<int>(N); ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+    }
+    while (consumer.sequence().load() != 29 + 4 * static_cast<long>(N))
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(tap_handler.handled_.load(), 20);
+    EXPECT_EQ(main_handler.handled_.load(), 30 + 4 * static_cast<long>(N));
+
+    // Attached again, the tap runs again and gates the producer again
+    disruptor.attach(&tap);
+    const long last = 29 + 8 * static_cast<long>(N);
+    for (long i = 30 + 4 * static_cast<long>(N); i <= last; ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+    }
+    while (tap.sequence().load() != last || consumer.sequence().load() != last)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(tap_handler.handled_.load(), 20 + 4 * static_cast<long>(N));
+
+    disruptor.halt();
+}
+
+TEST(DisruptorTest, SnapshotReportsRingAndProcessorMetrics)
+{
+    const size_t N = 8;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    CountingHandler handler;
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N> consumer(ring_buffer, sequencer, 7, &handler);
+
+    std::vector<EventProcessor<N>*> processors = {&consumer};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, YieldWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    for (int i = 0; i < 100; ++i)
+    {
+        // Every tenth payload is too long for the slot
+        producer.publish((i % 10 == 0 ? std::string(kEventValueCapacity, '.') : "Event ") + std::to_string(i));
+    }
+    while (consumer.sequence().load() != 99)
+    {
+        std::this_thread::yield();
+    }
+
+    RingSnapshot snapshot = disruptor.snapshot();
+    disruptor.halt();
+
+    EXPECT_EQ(snapshot.cursor, 99);
+    EXPECT_EQ(snapshot.producer_truncations, 10u);
+    ASSERT_EQ(snapshot.processors.size(), 1u);
+
+    const ProcessorSnapshot& processor = snapshot.processors[0];
+    EXPECT_EQ(processor.id, 7);
+    EXPECT_EQ(processor.sequence, 99);
+    EXPECT_EQ(processor.lag, 0);
+    EXPECT_EQ(processor.events, 100u);
+    EXPECT_GE(processor.batches, 1u);
+
+    uint64_t bucketed = 0;
+    for (uint64_t count : processor.batch_sizes)
+    {
+        bucketed += count;
+    }
+    EXPECT_EQ(bucketed, processor.batches);
+
+    // 100 events through an 8 slot ring: the producer gets gated, unless the
+    // consumer always kept up, in which case there is nothing to measure
+    if (snapshot.producer_stalls == 0)
+    {
+        EXPECT_EQ(snapshot.producer_stall_cycles, 0u);
+    }
+
+    // Round trip through the mapped stats file
+    char path[] = "/tmp/disruptor_metrics_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    {
+        MetricsFile file(path);
+        file.write(snapshot);
+    }
+
+    MetricsFileLayout layout;
+    fd = open(path, O_RDONLY);
+    ASSERT_EQ(read(fd, &layout, sizeof(layout)), static_cast<ssize_t>(sizeof(layout)));
+    close(fd);
+    unlink(path);
+
+    EXPECT_EQ(layout.version.load() % 2, 0u);
+    EXPECT_EQ(layout.cursor, 99);
+    EXPECT_EQ(layout.producer_truncations, 10u);
+    EXPECT_EQ(layout.num_processors, 1u);
+    EXPECT_EQ(layout.processors[0].events, 100u);
+}
+
+// Busy for roughly a microsecond per event
+class BusyHandler : public EventHandler
+{
+public:
+    void on_event(Event&, long, bool) override
+    {
+        const uint64_t until = rdtsc() + tsc_per_milli() / 1000;
+        while (rdtsc() < until)
+        {
+        }
+    }
+};
+
+TEST(DisruptorTest, SnapshotReportsDutyCycle)
+{
+    const size_t N = 8;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    BusyHandler handler;
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N> consumer(ring_buffer, sequencer, 3, &handler);
+
+    std::vector<EventProcessor<N>*> processors = {&consumer};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, YieldWaitStrategy> disruptor(processors, producers);
+    std::ostringstream summaries;
+    MetricsReporter<Disruptor<N, YieldWaitStrategy>> reporter(disruptor, summaries, std::chrono::milliseconds(5));
+    RingSnapshot before = disruptor.snapshot();
+    disruptor.start();
+    reporter.start();
+
+    for (int i = 0; i < 100; ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+    }
+    while (consumer.sequence().load() != 99)
+    {
+        std::this_thread::yield();
+    }
+    // Let it go idle so the wait strategy is charged too
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    RingSnapshot after = disruptor.snapshot();
+    reporter.stop();
+    disruptor.halt();
+
+    const ProcessorSnapshot& processor = after.processors[0];
+    EXPECT_GE(processor.handler_cycles, 100 * tsc_per_milli() / 1000);
+    EXPECT_GT(processor.wait_strategy_cycles, 0u);
+
+    const std::string summary = format_summary(before, after);
+    EXPECT_EQ(summary.rfind("processor=3 lag=0 events=100 events_per_batch=", 0), 0u) << summary;
+    EXPECT_NE(summary.find(" handler="), std::string::npos);
+    EXPECT_NE(summary.find(" wait_strategy="), std::string::npos);
+
+    EXPECT_EQ(summaries.str().rfind("processor=3 ", 0), 0u) << summaries.str();
+}
+
+TEST(DisruptorTest, TracerRecordsOnlySampledSequences)
+{
+    const size_t N = 16;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    CountingHandler handler;
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N> consumer(ring_buffer, sequencer, 0, &handler);
+
+    std::ostringstream out;
+    Tracer tracer(out);
+    TraceHeaders headers(N, TraceSampler(4));
+    producer.enable_tracing(headers);
+    consumer.enable_tracing(headers, 0, tracer.add_sink());
+
+    std::vector<EventProcessor<N>*> processors = {&consumer};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, YieldWaitStrategy> disruptor(processors, producers);
+    tracer.start();
+    disruptor.start();
+
+    for (int i = 0; i < 32; ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+    }
+    while (consumer.sequence().load() != 31)
+    {
+        std::this_thread::yield();
+    }
+
+    disruptor.halt();
+    tracer.stop();
+
+    std::istringstream lines(out.str());
+    std::string line;
+    std::vector<std::string> records;
+    while (std::getline(lines, line))
+    {
+        records.push_back(line);
+    }
+
+    ASSERT_EQ(records.size(), 8u);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        EXPECT_EQ(records[i].rfind("sequence=" + std::to_string(i * 4) + " stage=0 ", 0), 0u) << records[i];
+    }
+
+    // A mask only picks 1 in a power of two
+    EXPECT_THROW(TraceSampler(3), std::invalid_argument);
+    EXPECT_FALSE(TraceSampler(0).sampled(0));
+    EXPECT_THROW(TraceHeaders(N, TraceSampler(0)), std::invalid_argument);
+
+    // Tracing state lives beside the ring: an event is the same size
+    // whether or not its ring is traced
+    EXPECT_LE(sizeof(Event), 64u);
+}
+
+// Pairs each request with its response, one after the other, as
+// straight-line code
+Task correlate(Scheduler& scheduler,
+               const Sequencer& requests, RingBuffer<8>& request_ring,
+               const Sequencer& responses, RingBuffer<8>& response_ring,
+               long count, std::vector<std::string>& matched)
+{
+    for (long i = 0; i < count; ++i)
+    {
+        co_await scheduler.wait_for(requests, i);
+        std::string request(request_ring.get(i).get());
+
+        co_await scheduler.wait_for(responses, i);
+        matched.push_back(request + "->" + std::string(response_ring.get(i).get()));
+    }
+}
+
+TEST(DisruptorTest, CoroutineAwaitsSequences)
+{
+    const size_t N = 8;
+
+    Scheduler scheduler;
+    Sequencer requests;
+    Sequencer responses;
+    RingBuffer<N> request_ring;
+    RingBuffer<N> response_ring;
+    std::vector<std::string> matched;
+
+    scheduler.spawn(correlate(scheduler, requests, request_ring, responses, response_ring, 3, matched));
+    EXPECT_EQ(scheduler.suspended(), 1u);
+
+    // Nothing published yet: polling resumes nothing
+    EXPECT_EQ(scheduler.poll(), 0u);
+
+    for (long i = 0; i < 3; ++i)
+    {
+        long request = requests.next();
+        request_ring.get(request).set("req" + std::to_string(i));
+        requests.publish(request);
+        EXPECT_EQ(scheduler.poll(), 1u);
+        EXPECT_EQ(matched.size(), static_cast<size_t>(i));
+
+        long response = responses.next();
+        response_ring.get(response).set("rsp" + std::to_string(i));
+        responses.publish(response);
+        EXPECT_EQ(scheduler.poll(), 1u);
+        ASSERT_EQ(matched.size(), static_cast<size_t>(i + 1));
+        EXPECT_EQ(matched.back(), "req" + std::to_string(i) + "->rsp" + std::to_string(i));
+    }
+
+    // The coroutine returned and is gone
+    EXPECT_EQ(scheduler.suspended(), 0u);
+    scheduler.run();
+}
+
+TEST(DisruptorTest, FutexWaitStrategyParksIdleConsumer)
+{
+    const size_t N = 8;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    CountingHandler handler;
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N, FutexWaitStrategy> consumer(ring_buffer, sequencer, 0, &handler);
+    consumer.wait_strategy().set_spin_iterations(100);
+
+    std::vector<EventProcessor<N, FutexWaitStrategy>*> processors = {&consumer};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, FutexWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    // An idle consumer sleeps in the kernel instead of polling the cursor
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_LT(consumer.metrics().idle_spins.load(), 10u);
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 5; ++i)
+        {
+            producer.publish("Event " + std::to_string(i));
+        }
+        while (consumer.sequence().load() != 5 * round + 4)
+        {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(handler.handled_.load(), 15);
+
+    // halt() has to wake the parked consumer, or this would hang
+    disruptor.halt();
+}
+
+TEST(DisruptorTest, AdaptiveWaitStrategyTunesSpinBudget)
+{
+    const uint64_t cycles_per_us = tsc_per_milli() / 1000;
+    AdaptiveWaitStrategy strategy(/*max_spin_ns=*/100'000, /*min_spin_ns=*/1'000, /*spin_factor=*/2.0);
+
+    // Events every ~10us: spin for about twice that
+    for (int i = 0; i < 100; ++i)
+    {
+        strategy.record_idle_period(10 * cycles_per_us);
+    }
+    EXPECT_NEAR(static_cast<double>(strategy.spin_budget_cycles()), 20.0 * cycles_per_us, 1.0 * cycles_per_us);
+
+    // Overnight: gaps far beyond what we are willing to spin, so park at once
+    for (int i = 0; i < 100; ++i)
+    {
+        strategy.record_idle_period(1000 * cycles_per_us);
+    }
+    EXPECT_NEAR(static_cast<double>(strategy.spin_budget_cycles()), 1.0 * cycles_per_us, 0.1 * cycles_per_us);
+
+    // The open: spinning resumes within a few dozen events
+    for (int i = 0; i < 50; ++i)
+    {
+        strategy.record_idle_period(5 * cycles_per_us);
+    }
+    EXPECT_GT(strategy.spin_budget_cycles(), 10 * cycles_per_us);
+    EXPECT_LT(strategy.spin_budget_cycles(), 15 * cycles_per_us);
+}
+
+TEST(DisruptorTest, SnapshotReportsAdaptiveSpinBudget)
+{
+    const size_t N = 8;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    CountingHandler handler;
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N, AdaptiveWaitStrategy> consumer(ring_buffer, sequencer, 0, &handler);
+
+    std::vector<EventProcessor<N, AdaptiveWaitStrategy>*> processors = {&consumer};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, AdaptiveWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    for (int i = 0; i < 10; ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while (consumer.sequence().load() != 9)
+    {
+        std::this_thread::yield();
+    }
+
+    RingSnapshot snapshot = disruptor.snapshot();
+    disruptor.halt();
+
+    ASSERT_EQ(snapshot.processors.size(), 1u);
+    EXPECT_EQ(snapshot.processors[0].spin_budget_cycles, consumer.wait_strategy().spin_budget_cycles());
+    EXPECT_GT(snapshot.processors[0].spin_budget_cycles, 0u);
+    EXPECT_EQ(handler.handled_.load(), 10);
+}
+
+// Remembers which sequences it saw, and checks upstream saw them first
+class StampingHandler : public EventHandler
+{
+public:
+    StampingHandler(std::vector<std::atomic<int>>& stamps, int stage) : stamps_(stamps), stage_(stage) {}
+
+    void on_event(Event&, long sequence, bool) override
+    {
+        std::atomic<int>& stamp = stamps_[sequence];
+        if (stamp.load() != stage_ - 1)
+        {
+            ++out_of_order_;
+        }
+        stamp.store(stage_);
+    }
+
+    std::vector<std::atomic<int>>& stamps_;
+    int stage_;
+    long out_of_order_ = 0;
+};
+
+TEST(DisruptorTest, ProcessorWaitsForItsDependencies)
+{
+    const size_t N = 8;
+    const long events = 100;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    std::vector<std::atomic<int>> stamps(events);
+    for (auto& stamp : stamps)
+    {
+        stamp.store(-1);
+    }
+
+    StampingHandler first(stamps, 0);
+    StampingHandler second(stamps, 1);
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N> upstream(ring_buffer, sequencer, 0, &first);
+    EventProcessor<N> downstream(ring_buffer, sequencer, 1, &second);
+    downstream.add_dependency(upstream);
+
+    std::vector<EventProcessor<N>*> processors = {&upstream, &downstream};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, YieldWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    for (long i = 0; i < events; ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+    }
+    while (downstream.sequence().load() != events - 1)
+    {
+        std::this_thread::yield();
+    }
+    disruptor.halt();
+
+    EXPECT_EQ(first.out_of_order_, 0);
+    EXPECT_EQ(second.out_of_order_, 0);
+    for (const auto& stamp : stamps)
+    {
+        EXPECT_EQ(stamp.load(), 1);
+    }
+}
+
+class SlowHandler : public EventHandler
+{
+public:
+    void on_event(Event&, long, bool) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+};
+
+TEST(DisruptorTest, DependentProcessorWaitsOnItsBarrier)
+{
+    const size_t N = 8;
+
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+
+    SlowHandler slow;
+    CountingHandler handler;
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N, FutexWaitStrategy> upstream(ring_buffer, sequencer, 0, &slow);
+    EventProcessor<N, FutexWaitStrategy> downstream(ring_buffer, sequencer, 1, &handler);
+    downstream.add_dependency(upstream);
+
+    std::vector<EventProcessor<N, FutexWaitStrategy>*> processors = {&upstream, &downstream};
+    std::vector<Producer<N>*> producers = {&producer};
+
+    Disruptor<N, FutexWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    // The cursor is ahead while upstream is busy: downstream must wait on
+    // upstream's sequence, not return to its loop at once
+    for (int i = 0; i < 2; ++i)
+    {
+        producer.publish("Event " + std::to_string(i));
+    }
+    while (downstream.sequence().load() != 1)
+    {
+        std::this_thread::yield();
+    }
+    disruptor.halt();
+
+    EXPECT_EQ(handler.handled_.load(), 2);
+    EXPECT_LT(downstream.metrics().idle_spins.load(), 10u);
+}
+
+struct DiamondEvent
+{
+    long value;
+    long a;
+    long b;
+    long c;
+};
+
+struct StageA
+{
+    void on_event(DiamondEvent& event, long, bool) { event.a = event.value * 2; }
+};
+
+struct StageB
+{
+    void on_event(DiamondEvent& event, long, bool) { event.b = event.a + 1; }
+};
+
+struct StageC
+{
+    void on_event(DiamondEvent& event, long, bool) { event.c = event.a + 2; }
+};
+
+struct StageD
+{
+    void on_event(DiamondEvent& event, long, bool)
+    {
+        if (event.a != event.value * 2 || event.b != event.a + 1 || event.c != event.a + 2)
+        {
+            ++errors;
+        }
+        sum += event.value;
+    }
+
+    long errors = 0;
+    long sum = 0;
+};
+
+TEST(DisruptorTest, StaticPipelineRunsStepsInOrder)
+{
+    Pipeline<DiamondEvent, 8, YieldWaitStrategy, Stage<StageA>, Parallel<StageB, StageC>, Stage<StageD>> pipeline;
+    pipeline.start();
+
+    const long events = 1000;
+    for (long i = 0; i < events; ++i)
+    {
+        long sequence = pipeline.next();
+        pipeline.get(sequence) = DiamondEvent{i, 0, 0, 0};
+        pipeline.publish(sequence);
+    }
+    while (pipeline.sequence<2>().load() != events - 1)
+    {
+        std::this_thread::yield();
+    }
+    pipeline.halt();
+
+    EXPECT_EQ(pipeline.cursor(), events - 1);
+    EXPECT_EQ((pipeline.sequence<1, 0>().load()), events - 1);
+    EXPECT_EQ((pipeline.sequence<1, 1>().load()), events - 1);
+    EXPECT_EQ(pipeline.handler<2>().errors, 0);
+    EXPECT_EQ(pipeline.handler<2>().sum, events * (events - 1) / 2);
+}
+
+struct OrderSnapshot
+{
+    long sequence;
+    char levels[4096];
+};
+
+// Reads each snapshot through the pool and checks it is the one published
+class SnapshotHandler : public EventHandler
+{
+public:
+    explicit SnapshotHandler(const ObjectPool<OrderSnapshot, 17>& pool) : pool_(pool) {}
+
+    void on_event(Event& event, long sequence, bool) override
+    {
+        const OrderSnapshot& snapshot = pool_.get(event.handle());
+        if (snapshot.sequence != sequence || snapshot.levels[sizeof(snapshot.levels) - 1] != static_cast<char>(sequence))
+        {
+            ++errors_;
+        }
+    }
+
+    const ObjectPool<OrderSnapshot, 17>& pool_;
+    long errors_ = 0;
+};
+
+TEST(DisruptorTest, PooledEventsPublishWithoutAllocating)
+{
+    const size_t N = 16;
+    auto ring_buffer = std::make_shared<RingBuffer<N>>();
+    auto sequencer = std::make_shared<Sequencer>();
+    ObjectPool<OrderSnapshot, N + 1> pool;
+
+    SnapshotHandler handler(pool);
+    Producer<N> producer(ring_buffer, sequencer);
+    EventProcessor<N> consumer(ring_buffer, sequencer, 0, &handler);
+
+    std::vector<EventProcessor<N>*> processors = {&consumer};
+    std::vector<Producer<N>*> producers = {&producer};
+    Disruptor<N, YieldWaitStrategy> disruptor(processors, producers);
+    disruptor.start();
+
+    long sequence = -1;
+    auto publish = [&](long count) {
+        for (long i = 0; i < count; ++i)
+        {
+            // N handles sit in the ring, so the one spare is always free here
+            PoolHandle handle = pool.acquire();
+            ASSERT_NE(handle, kNoPoolHandle);
+            OrderSnapshot& snapshot = pool.get(handle);
+            snapshot.sequence = sequence + 1;
+            snapshot.levels[sizeof(snapshot.levels) - 1] = static_cast<char>(snapshot.sequence);
+            sequence = producer.publish(pool, handle);
+        }
+        while (consumer.sequence().load() != sequence)
+        {
+            std::this_thread::yield();
+        }
+    };
+
+    // Warm up until every slot holds a handle, then count
+    publish(2 * N);
+    const size_t malloc_calls = g_malloc_calls.load();
+    publish(100 * N);
+    EXPECT_EQ(g_malloc_calls.load(), malloc_calls);
+
+    disruptor.halt();
+    EXPECT_EQ(handler.errors_, 0);
+    EXPECT_EQ(pool.available(), 1u);
+}
+
+TEST(DisruptorTest, FixedStringStoresInlineAndTruncates)
+{
+    constexpr FixedString<8> constant("ORDER");
+    static_assert(constant.view() == "ORDER");
+    static_assert(sizeof(FixedString<15>) == 16);
+
+    FixedString<8> value("a long symbol");
+    EXPECT_EQ(value.view(), "a long s");
+    EXPECT_EQ(value.size(), 8u);
+    EXPECT_FALSE(value.assign("a long symbol"));
+    EXPECT_TRUE(value.assign("12345678"));
+
+    value = "BUY";
+    EXPECT_EQ(value, FixedString<8>("BUY"));
+    EXPECT_LT(value, FixedString<8>("SELL"));
+    EXPECT_EQ(std::hash<FixedString<8>>{}(value), std::hash<std::string>{}("BUY"));
+
+    Event event;
+    EXPECT_TRUE(event.set("Event 42"));
+    EXPECT_EQ(event.get(), "Event 42");
+    EXPECT_FALSE(event.set(std::string(kEventValueCapacity + 1, 'x')));
+    EXPECT_EQ(event.get().size(), kEventValueCapacity);
+}
+
+TEST(DisruptorTest, OrderTableGrowsPastHalfFull)
+{
+    EXPECT_THROW(OrderTable(1000), std::invalid_argument);
+
+    OrderTable table(16);
+    for (uint64_t id = 1; id <= 1000; ++id)
+    {
+        table.insert(OrderTable::Order{id, static_cast<uint32_t>(id), 100, 0, Side::Buy});
+    }
+    EXPECT_EQ(table.size(), 1000u);
+    EXPECT_GE(table.capacity(), 2000u);
+
+    for (uint64_t id = 1; id <= 1000; id += 2)
+    {
+        OrderTable::Order* order = table.find(id);
+        ASSERT_NE(order, nullptr);
+        EXPECT_EQ(order->price, id);
+        table.erase(order);
+    }
+    EXPECT_EQ(table.size(), 500u);
+    for (uint64_t id = 1; id <= 1000; ++id)
+    {
+        EXPECT_EQ(table.find(id) != nullptr, id % 2 == 0);
+    }
+}
+
+// A price trending far beyond the ladder's window, with stray quotes
+// further out still: the top of book must stay right throughout
+TEST(DisruptorTest, OrderBookFollowsPricesOutOfItsWindow)
+{
+    struct Resting
+    {
+        Side side;
+        uint32_t price;
+        uint32_t shares;
+    };
+
+    std::mt19937_64 random(7);
+    OrderBook book(1'000'000);
+    std::vector<Resting> resting;
+    std::map<uint32_t, uint32_t> bids;
+    std::map<uint32_t, uint32_t> asks;
+    uint32_t mid = 1'000'000;
+
+    for (int i = 0; i < 50000; ++i)
+    {
+        if (resting.size() < 64 || random() % 2)
+        {
+            mid += 3;
+            const Side side = random() % 2 ? Side::Buy : Side::Sell;
+            uint32_t offset = 1 + static_cast<uint32_t>(random() % 100);
+            if (random() % 50 == 0)
+            {
+                offset += 100'000;   // a stray quote far from the touch
+            }
+            const Resting order{side, side == Side::Buy ? mid - offset : mid + offset, 100};
+            book.add(order.side, order.price, order.shares);
+            (side == Side::Buy ? bids : asks)[order.price] += order.shares;
+            resting.push_back(order);
+        }
+        else
+        {
+            const size_t index = random() % resting.size();
+            const Resting order = resting[index];
+            resting[index] = resting.back();
+            resting.pop_back();
+            book.reduce(order.side, order.price, order.shares);
+            auto& levels = order.side == Side::Buy ? bids : asks;
+            if ((levels[order.price] -= order.shares) == 0)
+            {
+                levels.erase(order.price);
+            }
+        }
+
+        const OrderBook::Top top = book.top();
+        ASSERT_EQ(top.bid_price, bids.empty() ? 0 : bids.rbegin()->first) << i;
+        ASSERT_EQ(top.bid_shares, bids.empty() ? 0 : bids.rbegin()->second) << i;
+        ASSERT_EQ(top.ask_price, asks.empty() ? 0 : asks.begin()->first) << i;
+        ASSERT_EQ(top.ask_shares, asks.empty() ? 0 : asks.begin()->second) << i;
+    }
+
+    EXPECT_GT(mid - 1'000'000, 10 * OrderBook::kLevels);
+    EXPECT_GT(book.recenters(), 0u);
+    EXPECT_GT(book.out_of_range(), 0u);
+}
+
+// The ladder book must agree with a plain std::map book on every message
+TEST(DisruptorTest, OrderBookMatchesReferenceBook)
+{
+    SyntheticFeed feed(4);
+    auto builder = std::make_unique<BookBuilder>();
+
+    struct Resting
+    {
+        uint16_t instrument;
+        Side side;
+        uint32_t price;
+        uint32_t shares;
+    };
+    std::map<uint64_t, Resting> orders;
+    std::map<uint16_t, std::map<uint32_t, uint32_t>> bids;
+    std::map<uint16_t, std::map<uint32_t, uint32_t>> asks;
+
+    MarketEvent event{};
+    for (long i = 0; i < 200000; ++i)
+    {
+        feed.next(event);
+        builder->on_event(event, i, true);
+
+        if (event.type == MessageType::AddOrder)
+        {
+            orders[event.order_id] = Resting{event.instrument, event.side, event.price, event.shares};
+            (event.side == Side::Buy ? bids : asks)[event.instrument][event.price] += event.shares;
+        }
+        else if (event.type == MessageType::OrderReplace)
+        {
+            Resting order = orders.at(event.order_id);
+            auto& levels = (order.side == Side::Buy ? bids : asks)[order.instrument];
+            if ((levels[order.price] -= order.shares) == 0)
+            {
+                levels.erase(order.price);
+            }
+            orders.erase(event.order_id);
+            orders[event.new_order_id] = Resting{order.instrument, order.side, event.price, event.shares};
+            levels[event.price] += event.shares;
+        }
+        else
+        {
+            Resting& order = orders.at(event.order_id);
+            const uint32_t shares = event.type == MessageType::OrderDelete ? order.shares : event.shares;
+            auto& levels = (order.side == Side::Buy ? bids : asks)[order.instrument];
+            if ((levels[order.price] -= shares) == 0)
+            {
+                levels.erase(order.price);
+            }
+            if ((order.shares -= shares) == 0)
+            {
+                orders.erase(event.order_id);
+            }
+        }
+
+        const auto& instrument_bids = bids[event.instrument];
+        const auto& instrument_asks = asks[event.instrument];
+        ASSERT_EQ(event.bid_price, instrument_bids.empty() ? 0u : instrument_bids.rbegin()->first) << i;
+        ASSERT_EQ(event.bid_shares, instrument_bids.empty() ? 0u : instrument_bids.rbegin()->second) << i;
+        ASSERT_EQ(event.ask_price, instrument_asks.empty() ? 0u : instrument_asks.begin()->first) << i;
+        ASSERT_EQ(event.ask_shares, instrument_asks.empty() ? 0u : instrument_asks.begin()->second) << i;
+    }
+    EXPECT_EQ(builder->unknown_orders(), 0u);
+}
+
+TEST(DisruptorTest, OrderBookPipelineFiresSignals)
+{
+    auto pipeline = std::make_unique<OrderBookPipeline<1024>>();
+    SyntheticFeed feed;
+    pipeline->start();
+
+    long sequence = -1;
+    for (long i = 0; i < 100000; ++i)
+    {
+        sequence = publish_next(*pipeline, feed);
+    }
+    while (pipeline->sequence<1>().load() != sequence)
+    {
+        std::this_thread::yield();
+    }
+    pipeline->halt();
+
+    SignalGenerator& signal = pipeline->handler<1>();
+    EXPECT_EQ(signal.latencies().recorded(), 100000u);
+    EXPECT_GT(signal.buy_signals() + signal.sell_signals(), 0u);
+    EXPECT_EQ(pipeline->handler<0>().unknown_orders(), 0u);
+}
+
+TEST(DisruptorTest, ItchParserDecodesWhatWasWritten)
+{
+    SyntheticFeed feed;
+    ItchWriter writer;
+    std::vector<MarketEvent> written(10000);
+    for (size_t i = 0; i < written.size(); ++i)
+    {
+        feed.next(written[i]);
+        writer.write(written[i]);
+        if (i % 100 == 0)
+        {
+            writer.write_other('S', 12, written[i].timestamp_ns);
+        }
+    }
+    std::string capture = writer.data();
+    capture.append("\x00\x24" "A", 3);   // a truncated add order
+
+    ItchParser parser(capture.data(), capture.size());
+    MarketEvent decoded{};
+    for (const MarketEvent& expected : written)
+    {
+        ASSERT_TRUE(parser.has_next());
+        EXPECT_EQ(parser.next_timestamp(), expected.timestamp_ns);
+        parser.decode(decoded);
+
+        ASSERT_EQ(decoded.type, expected.type);
+        EXPECT_EQ(decoded.instrument, expected.instrument);
+        EXPECT_EQ(decoded.order_id, expected.order_id);
+        EXPECT_EQ(decoded.timestamp_ns, expected.timestamp_ns);
+        if (expected.type != MessageType::OrderDelete)
+        {
+            EXPECT_EQ(decoded.shares, expected.shares);
+        }
+        if (expected.type == MessageType::AddOrder)
+        {
+            EXPECT_EQ(decoded.side, expected.side);
+            EXPECT_EQ(decoded.price, expected.price);
+        }
+        if (expected.type == MessageType::OrderReplace)
+        {
+            EXPECT_EQ(decoded.new_order_id, expected.new_order_id);
+            EXPECT_EQ(decoded.price, expected.price);
+        }
+    }
+    EXPECT_FALSE(parser.has_next());
+    EXPECT_TRUE(parser.truncated());
+    EXPECT_EQ(parser.decoded(), written.size());
+    EXPECT_EQ(parser.skipped(), 100u);
+}
+
+TEST(DisruptorTest, ItchReplayFeedsOrderBookPipeline)
+{
+    char path[] = "/tmp/disruptor_itch_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    record_synthetic_capture(path, 50000);
+
+    ItchCapture capture(path);
+    unlink(path);
+    ItchParser parser(capture);
+
+    auto pipeline = std::make_unique<OrderBookPipeline<1024>>();
+    pipeline->start();
+    const long sequence = replay(*pipeline, parser, ReplayMode::FlatOut);
+    while (pipeline->sequence<1>().load() != sequence)
+    {
+        std::this_thread::yield();
+    }
+    pipeline->halt();
+
+    EXPECT_EQ(sequence, 49999);
+    EXPECT_FALSE(parser.truncated());
+    EXPECT_EQ(pipeline->handler<0>().unknown_orders(), 0u);
+    EXPECT_EQ(pipeline->handler<1>().latencies().recorded(), 50000u);
+
+    // Recorded gaps: the synthetic feed's average 500ns gap makes 1000
+    // messages take about half a millisecond
+    parser.rewind();
+    auto paced = std::make_unique<OrderBookPipeline<1024>>();
+    paced->start();
+    const auto start = std::chrono::steady_clock::now();
+    replay(*paced, parser, ReplayMode::Recorded, 1.0, 1000);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    paced->halt();
+    EXPECT_GE(elapsed, std::chrono::microseconds(300));
+
+    // Timestamps going backwards are due at once, not after the unsigned
+    // difference wraps
+    SyntheticFeed feed;
+    ItchWriter writer;
+    MarketEvent event{};
+    for (uint64_t i = 0; i < 100; ++i)
+    {
+        feed.next(event);
+        event.timestamp_ns = 1'000'000 - i;
+        writer.write(event);
+    }
+    const std::string backwards = writer.data();
+    ItchParser backwards_parser(backwards.data(), backwards.size());
+    auto unordered = std::make_unique<OrderBookPipeline<1024>>();
+    unordered->start();
+    const auto backwards_start = std::chrono::steady_clock::now();
+    EXPECT_EQ(replay(*unordered, backwards_parser, ReplayMode::Recorded), 99);
+    EXPECT_LT(std::chrono::steady_clock::now() - backwards_start, std::chrono::seconds(1));
+    unordered->halt();
+}
+
+TEST(DisruptorTest, LoggerFormatsRecordsFromEveryThread)
+{
+    std::ostringstream out;
+    {
+        Logger logger(out, std::chrono::microseconds(10));
+        logger.start();
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 3; ++t)
+        {
+            threads.emplace_back([&logger, t]() {
+                for (int i = 0; i < 2000; ++i)
+                {
+                    logger.log("thread {} line {}", t, i);
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        logger.log("{} {} {} {} {} {}", -42, 7u, 2.5, true, 'x', std::string("text"));
+        logger.log("no args {}");
+    }
+
+    std::istringstream lines(out.str());
+    std::map<int, int> next_line;
+    std::vector<std::string> others;
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        int thread, number;
+        if (std::sscanf(line.c_str(), "thread %d line %d", &thread, &number) == 2)
+        {
+            // Each thread's lines stay in order
+            EXPECT_EQ(number, next_line[thread]++);
+        }
+        else
+        {
+            others.push_back(line);
+        }
+    }
+
+    EXPECT_EQ(next_line[0], 2000);
+    EXPECT_EQ(next_line[1], 2000);
+    EXPECT_EQ(next_line[2], 2000);
+    ASSERT_EQ(others.size(), 2u);
+    EXPECT_EQ(others[0], "-42 7 2.5 true x text");
+    EXPECT_EQ(others[1], "no args {}");
+}
+
+TEST(DisruptorTest, LoggerReusesRingsOfExitedThreads)
+{
+    std::ostringstream out;
+    uint64_t dropped;
+    {
+        Logger logger(out, std::chrono::microseconds(10));
+        logger.start();
+
+        // Far more threads than rings, one after another
+        for (size_t t = 0; t < 3 * kLogMaxThreads; ++t)
+        {
+            std::thread([&logger, t]() { logger.log("thread {}", t); }).join();
+        }
+
+        // Every ring held at once: the next thread's line is dropped
+        std::atomic<size_t> logged{0};
+        std::atomic<bool> done{false};
+        std::vector<std::thread> holders;
+        for (size_t t = 0; t < kLogMaxThreads; ++t)
+        {
+            holders.emplace_back([&]() {
+                logger.log("holder");
+                logged.fetch_add(1);
+                while (!done.load())
+                {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        while (logged.load() < kLogMaxThreads)
+        {
+            std::this_thread::yield();
+        }
+        std::thread([&logger]() { logger.log("dropped"); }).join();
+        done.store(true);
+        for (auto& holder : holders)
+        {
+            holder.join();
+        }
+        dropped = logger.dropped();
+    }
+
+    std::istringstream lines(out.str());
+    std::string line;
+    size_t threads = 0, holders = 0;
+    while (std::getline(lines, line))
+    {
+        threads += line.starts_with("thread ");
+        holders += line == "holder";
+        EXPECT_NE(line, "dropped");
+    }
+    EXPECT_EQ(threads, 3 * kLogMaxThreads);
+    EXPECT_EQ(holders, kLogMaxThreads);
+    EXPECT_EQ(dropped, 1u);
+}
+
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
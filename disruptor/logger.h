@@ -0,0 +1,406 @@
+#pragma once
+
+#include "sequence.h"
+#include "sequencer.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Asynchronous logger
+/*
+    -   The calling thread does no formatting and no allocation: log()
+        claims a slot in the thread's own ring, stores the format string's
+        pointer and the raw arguments, and publishes. That is a few stores
+        and a release, instead of the locale-aware formatting and
+        synchronous write of std::cout.
+
+    -   Each thread gets its own single producer ring the first time it
+        logs, so threads never contend with each other, and gives it back
+        when it exits, for a later thread to reuse. A background thread
+        drains every ring, formats the records and writes each pass as one
+        batch. Lines from different threads may interleave in any order.
+
+    -   At most kLogMaxThreads threads hold a ring at once. The lines of any
+        further thread are dropped and counted in dropped(): log() is
+        called on hot paths, where throwing is not an option.
+
+    -   Formats use {} placeholders, filled in order. The format must be a
+        string literal: only its pointer is kept. Arguments are integers,
+        floating point numbers, bools, chars and strings; strings are copied
+        into the slot (at most kLogStringBytes for all of a record's
+        strings together, the rest is cut off).
+
+    -   A full ring makes the caller wait, as any producer does; a thread
+        with a ring never loses a line. start() the logger before a thread
+        logs more than kLogRingSize lines.
+*/
+constexpr size_t kLogMaxArgs = 8;
+constexpr size_t kLogStringBytes = 64;
+constexpr size_t kLogRingSize = 1024;
+constexpr size_t kLogMaxThreads = 64;
+
+enum class LogArgType : uint8_t
+{
+    Int,
+    UInt,
+    Double,
+    Bool,
+    Char,
+    String,
+};
+
+struct alignas(kCacheLineSize) LogRecord
+{
+    union Arg
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+        struct
+        {
+            uint16_t offset;
+            uint16_t length;
+        } s;
+    };
+
+    const char* format;
+    uint8_t arg_count;
+    uint8_t string_bytes;
+    std::array<LogArgType, kLogMaxArgs> types;
+    std::array<Arg, kLogMaxArgs> args;
+    std::array<char, kLogStringBytes> strings;
+};
+
+class Logger
+{
+public:
+    explicit Logger(std::ostream& out, std::chrono::microseconds idle_sleep = std::chrono::microseconds(100))
+        : id_(next_id()), out_(out), idle_sleep_(idle_sleep)
+    {
+    }
+
+    // Writes everything logged before it returns
+    ~Logger()
+    {
+        stop();
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void start()
+    {
+        running_.store(true, std::memory_order_relaxed);
+        writer_ = std::thread([this]() {
+            while (running_.load(std::memory_order_relaxed))
+            {
+                if (!drain())
+                {
+                    std::this_thread::sleep_for(idle_sleep_);
+                }
+            }
+            drain();
+        });
+    }
+
+    void stop()
+    {
+        running_.store(false, std::memory_order_relaxed);
+        if (writer_.joinable())
+        {
+            writer_.join();
+        }
+    }
+
+    template <size_t FormatSize, typename... Args>
+    void log(const char (&format)[FormatSize], const Args&... args)
+    {
+        static_assert(sizeof...(Args) <= kLogMaxArgs, "too many log arguments");
+
+        Ring* ring = thread_ring();
+        if (ring == nullptr) [[unlikely]]
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        const long sequence = ring->sequencer.next();
+        LogRecord& record = ring->records[sequence & (kLogRingSize - 1)];
+        record.format = format;
+        record.arg_count = 0;
+        record.string_bytes = 0;
+        (encode(record, args), ...);
+        ring->sequencer.publish(sequence);
+    }
+
+    // Lines of threads that found every ring taken
+    uint64_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring
+    {
+        Ring() : sequencer(kLogRingSize)
+        {
+            sequencer.add_gating_sequence(&consumed.value);
+        }
+
+        std::atomic<bool> owned{true};
+        Sequencer sequencer;
+        Sequence consumed;
+        std::array<LogRecord, kLogRingSize> records;
+    };
+
+    // A thread's rings, given back when it exits. Weak, so that a logger
+    // destroyed before the thread exits is skipped.
+    struct ThreadRings
+    {
+        struct Entry
+        {
+            uint64_t logger_id;
+            std::weak_ptr<Ring> ring;
+        };
+
+        ~ThreadRings()
+        {
+            for (const Entry& entry : entries)
+            {
+                if (std::shared_ptr<Ring> ring = entry.ring.lock())
+                {
+                    ring->owned.store(false, std::memory_order_release);
+                }
+            }
+        }
+
+        std::vector<Entry> entries;
+    };
+
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> ids{0};
+        return ++ids;
+    }
+
+    // The calling thread's ring, registered on its first log() call;
+    // nullptr if every ring is taken. The cache is keyed by the logger's
+    // id, not its address, which a later logger may reuse.
+    Ring* thread_ring()
+    {
+        thread_local uint64_t cached_logger = 0;
+        thread_local Ring* cached_ring = nullptr;
+        thread_local ThreadRings thread_rings;
+
+        if (cached_logger != id_) [[unlikely]]
+        {
+            Ring* ring = register_thread(thread_rings);
+            if (ring == nullptr)
+            {
+                return nullptr;     // not cached: a ring may come free
+            }
+            cached_ring = ring;
+            cached_logger = id_;
+        }
+        return cached_ring;
+    }
+
+    // Reuses a ring an exited thread gave back before adding one
+    Ring* register_thread(ThreadRings& thread_rings)
+    {
+        for (const ThreadRings::Entry& entry : thread_rings.entries)
+        {
+            if (entry.logger_id == id_)
+            {
+                return entry.ring.lock().get();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+
+        std::shared_ptr<Ring> ring;
+        const size_t count = ring_count_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < count && !ring; ++i)
+        {
+            bool owned = false;
+            if (rings_[i]->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+            {
+                ring = rings_[i];
+            }
+        }
+
+        if (!ring)
+        {
+            if (count == kLogMaxThreads)
+            {
+                return nullptr;
+            }
+            ring = std::make_shared<Ring>();
+            rings_[count] = ring;
+            ring_count_.store(count + 1, std::memory_order_release);
+        }
+
+        std::erase_if(thread_rings.entries, [](const ThreadRings::Entry& entry) { return entry.ring.expired(); });
+        thread_rings.entries.push_back(ThreadRings::Entry{id_, ring});
+        return ring.get();
+    }
+
+    template <typename T>
+    static void encode(LogRecord& record, const T& value)
+    {
+        const uint8_t index = record.arg_count++;
+        LogRecord::Arg& arg = record.args[index];
+
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            record.types[index] = LogArgType::Bool;
+            arg.u = value;
+        }
+        else if constexpr (std::is_same_v<T, char>)
+        {
+            record.types[index] = LogArgType::Char;
+            arg.u = static_cast<unsigned char>(value);
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        {
+            record.types[index] = LogArgType::Int;
+            arg.i = value;
+        }
+        else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+        {
+            record.types[index] = LogArgType::UInt;
+            arg.u = static_cast<uint64_t>(value);
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            record.types[index] = LogArgType::Double;
+            arg.d = value;
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        {
+            const std::string_view text(value);
+            const size_t length = std::min(text.size(), kLogStringBytes - record.string_bytes);
+            std::memcpy(record.strings.data() + record.string_bytes, text.data(), length);
+
+            record.types[index] = LogArgType::String;
+            arg.s.offset = record.string_bytes;
+            arg.s.length = static_cast<uint16_t>(length);
+            record.string_bytes += length;
+        }
+        else
+        {
+            static_assert(sizeof(T) == 0, "unsupported log argument type");
+        }
+    }
+
+    // Returns whether there was anything to write
+    bool drain()
+    {
+        batch_.clear();
+        const size_t count = ring_count_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i)
+        {
+            Ring& ring = *rings_[i];
+            const long available = ring.sequencer.cursor();
+            long next = ring.consumed.value.load(std::memory_order_relaxed) + 1;
+            if (available < next)
+            {
+                continue;
+            }
+            for (; next <= available; ++next)
+            {
+                format(ring.records[next & (kLogRingSize - 1)], batch_);
+            }
+            ring.consumed.value.store(available, std::memory_order_release);
+        }
+
+        if (batch_.empty())
+        {
+            return false;
+        }
+        out_.write(batch_.data(), batch_.size());
+        out_.flush();
+        return true;
+    }
+
+    static void format(const LogRecord& record, std::string& out)
+    {
+        size_t arg = 0;
+        for (const char* p = record.format; *p; ++p)
+        {
+            if (p[0] == '{' && p[1] == '}' && arg < record.arg_count)
+            {
+                format_arg(record, arg++, out);
+                ++p;
+                continue;
+            }
+            out += *p;
+        }
+        out += '\n';
+    }
+
+    static void format_arg(const LogRecord& record, size_t index, std::string& out)
+    {
+        const LogRecord::Arg& arg = record.args[index];
+        char buffer[32];
+        std::to_chars_result result{buffer, std::errc()};
+
+        switch (record.types[index])
+        {
+        case LogArgType::Int:
+            result = std::to_chars(buffer, buffer + sizeof(buffer), arg.i);
+            break;
+        case LogArgType::UInt:
+            result = std::to_chars(buffer, buffer + sizeof(buffer), arg.u);
+            break;
+        case LogArgType::Double:
+            result = std::to_chars(buffer, buffer + sizeof(buffer), arg.d);
+            break;
+        case LogArgType::Bool:
+            out += arg.u ? "true" : "false";
+            return;
+        case LogArgType::Char:
+            out += static_cast<char>(arg.u);
+            return;
+        case LogArgType::String:
+            out.append(record.strings.data() + arg.s.offset, arg.s.length);
+            return;
+        }
+        out.append(buffer, result.ptr);
+    }
+
+    const uint64_t id_;
+    std::ostream& out_;
+    std::chrono::microseconds idle_sleep_;
+
+    std::mutex registry_mutex_;
+    std::array<std::shared_ptr<Ring>, kLogMaxThreads> rings_;
+    std::atomic<size_t> ring_count_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::string batch_;  // writer thread only
+    std::atomic<bool> running_{false};
+    std::thread writer_;
+};
+
+// Writes to std::cout; started on first use, drained at exit
+inline Logger& default_logger()
+{
+    static Logger logger(std::cout);
+    static const bool started = (logger.start(), true);
+    (void)started;
+    return logger;
+}
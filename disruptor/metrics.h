@@ -0,0 +1,222 @@
+#pragma once
+
+#include "sequence.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+// Runtime metrics for rings and processors
+/*
+    -   Every counter has exactly one writer: the producer owns its
+        ProducerMetrics, each processor its ProcessorMetrics. Each block is
+        aligned to its own cache lines, so writers never false-share with one
+        another or with the sequences the ring runs on.
+
+    -   A single writer does not need a locked read-modify-write. add() is a
+        relaxed load plus a relaxed store (a plain mov on x86); the atomic
+        type only keeps a concurrent reader from seeing a torn value.
+
+    -   A processor's time is split three ways, in TSC cycles: running
+        handlers, waiting (polling the barrier and finding nothing new), and
+        inside the wait strategy. Each is charged from two rdtsc per batch
+        or per idle poll, never per event. Handler time over the total is
+        the processor's duty cycle: as it approaches 100% the processor is
+        saturated, before its lag and latency start to grow.
+
+    -   A monitoring thread reads the blocks with relaxed loads through
+        Disruptor::snapshot(). Counters are not read at one instant, so a
+        snapshot is only approximately consistent, which is fine for
+        monitoring and costs the hot path nothing.
+*/
+class MetricCounter
+{
+public:
+    void add(uint64_t n = 1)
+    {
+        value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    uint64_t load() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+struct alignas(kCacheLineSize) ProducerMetrics
+{
+    MetricCounter stalls;        // claims that had to wait for a consumer
+    MetricCounter stall_cycles;  // TSC cycles spent waiting in those claims
+    MetricCounter truncations;   // payloads cut to kEventValueCapacity
+};
+
+// Batch sizes are bucketed by powers of two: bucket i counts the batches of
+// [2^i, 2^(i+1)) events, the last bucket everything larger.
+constexpr size_t kBatchSizeBuckets = 16;
+
+inline size_t batch_size_bucket(long batch_size)
+{
+    size_t bucket = 63 - __builtin_clzl(static_cast<unsigned long>(batch_size));
+    return bucket < kBatchSizeBuckets ? bucket : kBatchSizeBuckets - 1;
+}
+
+struct alignas(kCacheLineSize) ProcessorMetrics
+{
+    MetricCounter events;
+    MetricCounter batches;
+    MetricCounter idle_spins;    // polls of the cursor that found nothing new
+    std::array<MetricCounter, kBatchSizeBuckets> batch_sizes;
+    MetricCounter handler_cycles;
+    MetricCounter waiting_cycles;
+    MetricCounter wait_strategy_cycles;
+
+    void on_batch(long batch_size)
+    {
+        events.add(batch_size);
+        batches.add();
+        batch_sizes[batch_size_bucket(batch_size)].add();
+    }
+};
+
+struct ProcessorSnapshot
+{
+    int id;
+    long sequence;
+    long lag;                    // cursor - sequence
+    uint64_t events;
+    uint64_t batches;
+    uint64_t idle_spins;
+    std::array<uint64_t, kBatchSizeBuckets> batch_sizes;
+    uint64_t spin_budget_cycles; // chosen by an adaptive wait strategy, else 0
+    uint64_t handler_cycles;
+    uint64_t waiting_cycles;
+    uint64_t wait_strategy_cycles;
+};
+
+struct RingSnapshot
+{
+    long cursor;
+    uint64_t producer_stalls;
+    uint64_t producer_stall_cycles;
+    uint64_t producer_truncations;
+    std::vector<ProcessorSnapshot> processors;
+};
+
+// One line per processor describing the interval between two snapshots:
+//   processor=<id> lag=<n> events=<n> events_per_batch=<x> handler=<%> waiting=<%> wait_strategy=<%>
+// Processors are matched by position, so take both from the same ring.
+inline std::string format_summary(const RingSnapshot& previous, const RingSnapshot& current)
+{
+    std::string out;
+    for (size_t i = 0; i < current.processors.size(); ++i)
+    {
+        const ProcessorSnapshot& now = current.processors[i];
+        ProcessorSnapshot before{};
+        if (i < previous.processors.size() && previous.processors[i].id == now.id)
+        {
+            before = previous.processors[i];
+        }
+
+        const uint64_t events = now.events - before.events;
+        const uint64_t batches = now.batches - before.batches;
+        const uint64_t handler = now.handler_cycles - before.handler_cycles;
+        const uint64_t waiting = now.waiting_cycles - before.waiting_cycles;
+        const uint64_t wait_strategy = now.wait_strategy_cycles - before.wait_strategy_cycles;
+        const double total = static_cast<double>(std::max<uint64_t>(handler + waiting + wait_strategy, 1));
+
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "processor=%d lag=%ld events=%lu events_per_batch=%.1f handler=%.1f%% waiting=%.1f%% wait_strategy=%.1f%%\n",
+                      now.id, now.lag, events, batches ? static_cast<double>(events) / batches : 0.0,
+                      100.0 * handler / total, 100.0 * waiting / total, 100.0 * wait_strategy / total);
+        out += line;
+    }
+    return out;
+}
+
+// A snapshot mirrored into a memory mapped file, so tools outside the
+// process can watch the ring (e.g. a dashboard tailing /dev/shm).
+/*
+    -   The file is a MetricsFileLayout. write() bumps version to odd, copies
+        the snapshot in and bumps it back to even; a reader copies the
+        record and retries if version was odd or changed meanwhile.
+
+    -   Only the monitoring thread writes the file, never the ring's threads.
+*/
+constexpr size_t kMetricsFileMaxProcessors = 32;
+
+struct MetricsFileLayout
+{
+    std::atomic<uint64_t> version;
+    long cursor;
+    uint64_t producer_stalls;
+    uint64_t producer_stall_cycles;
+    uint64_t producer_truncations;
+    uint64_t num_processors;
+    ProcessorSnapshot processors[kMetricsFileMaxProcessors];
+};
+
+class MetricsFile
+{
+public:
+    explicit MetricsFile(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            throw std::runtime_error("MetricsFile: cannot open " + path);
+        }
+
+        if (ftruncate(fd, sizeof(MetricsFileLayout)) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("MetricsFile: cannot resize " + path);
+        }
+
+        void* addr = mmap(nullptr, sizeof(MetricsFileLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            throw std::runtime_error("MetricsFile: cannot map " + path);
+        }
+        layout_ = static_cast<MetricsFileLayout*>(addr);
+    }
+
+    ~MetricsFile()
+    {
+        munmap(layout_, sizeof(MetricsFileLayout));
+    }
+
+    MetricsFile(const MetricsFile&) = delete;
+    MetricsFile& operator=(const MetricsFile&) = delete;
+
+    void write(const RingSnapshot& snapshot)
+    {
+        uint64_t version = layout_->version.load(std::memory_order_relaxed);
+        layout_->version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        layout_->cursor = snapshot.cursor;
+        layout_->producer_stalls = snapshot.producer_stalls;
+        layout_->producer_stall_cycles = snapshot.producer_stall_cycles;
+        layout_->producer_truncations = snapshot.producer_truncations;
+        layout_->num_processors = std::min(snapshot.processors.size(), kMetricsFileMaxProcessors);
+        std::memcpy(layout_->processors, snapshot.processors.data(), layout_->num_processors * sizeof(ProcessorSnapshot));
+
+        layout_->version.store(version + 2, std::memory_order_release);
+    }
+
+private:
+    MetricsFileLayout* layout_;
+};
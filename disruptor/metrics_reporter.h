@@ -0,0 +1,76 @@
+#pragma once
+
+#include "metrics.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+// Writes a summary of a ring every interval, see format_summary()
+/*
+    -   Ring is anything with RingSnapshot snapshot() const, e.g. a
+        Disruptor. Each summary covers the interval since the previous one,
+        so the percentages are the current duty cycle rather than an average
+        since start.
+
+    -   Runs on its own thread and only reads the ring's counters, the same
+        as any other monitoring thread.
+*/
+template <typename Ring>
+class MetricsReporter
+{
+public:
+    MetricsReporter(const Ring& ring, std::ostream& out, std::chrono::milliseconds interval = std::chrono::seconds(1))
+        : ring_(ring), out_(out), interval_(interval)
+    {
+    }
+
+    ~MetricsReporter()
+    {
+        stop();
+    }
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    void start()
+    {
+        running_ = true;
+        reporter_ = std::thread([this]() {
+            RingSnapshot previous = ring_.snapshot();
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!stopped_.wait_for(lock, interval_, [this]() { return !running_; }))
+            {
+                RingSnapshot current = ring_.snapshot();
+                const std::string summary = format_summary(previous, current);
+                out_.write(summary.data(), summary.size());
+                out_.flush();
+                previous = std::move(current);
+            }
+        });
+    }
+
+    // Returns without waiting out the current interval
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        stopped_.notify_all();
+        if (reporter_.joinable())
+        {
+            reporter_.join();
+        }
+    }
+
+private:
+    const Ring& ring_;
+    std::ostream& out_;
+    std::chrono::milliseconds interval_;
+    std::mutex mutex_;
+    std::condition_variable stopped_;
+    bool running_ = false;  // guarded by mutex_
+    std::thread reporter_;
+};
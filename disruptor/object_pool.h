@@ -0,0 +1,93 @@
+#pragma once
+
+#include "sequence.h"
+#include <cstdint>
+#include <memory>
+
+using PoolHandle = uint32_t;
+constexpr PoolHandle kNoPoolHandle = UINT32_MAX;
+
+// Preallocated objects for events too large to copy into a slot
+/*
+    -   The producer acquire()s an object, fills it in place and publishes
+        its handle (Producer::publish(pool, handle)); the slot carries four
+        bytes instead of a multi KB payload, and consumers read the object
+        through the pool.
+
+    -   An object goes back to the pool when the producer claims the slot
+        holding its handle again. By then the sequencer has already waited
+        for every gating consumer to pass that sequence, so nobody can still
+        be reading it. Only the producer thread touches the free list: no
+        atomics, no allocation after construction.
+
+    -   Every object starts on its own cache line, so a consumer reading one
+        never false-shares with the producer filling the next.
+
+    -   Capacity must exceed the ring size: N handles sit in the slots, the
+        rest are what the producer may hold between acquire() and publish.
+*/
+template <typename T, size_t Capacity>
+class ObjectPool
+{
+    static_assert(Capacity < kNoPoolHandle, "ObjectPool capacity must fit in a PoolHandle");
+
+public:
+    ObjectPool()
+        : objects_(std::make_unique<Slot[]>(Capacity)), free_(std::make_unique<PoolHandle[]>(Capacity)),
+        free_count_(Capacity)
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+        {
+            free_[i] = static_cast<PoolHandle>(Capacity - 1 - i);
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Producer thread only. Returns kNoPoolHandle if every object is in use.
+    PoolHandle acquire()
+    {
+        if (free_count_ == 0)
+        {
+            return kNoPoolHandle;
+        }
+        return free_[--free_count_];
+    }
+
+    // Producer thread only
+    void release(PoolHandle handle)
+    {
+        free_[free_count_++] = handle;
+    }
+
+    T& get(PoolHandle handle)
+    {
+        return objects_[handle].object;
+    }
+
+    const T& get(PoolHandle handle) const
+    {
+        return objects_[handle].object;
+    }
+
+    size_t available() const
+    {
+        return free_count_;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+private:
+    struct alignas(kCacheLineSize) Slot
+    {
+        T object;
+    };
+
+    std::unique_ptr<Slot[]> objects_;
+    std::unique_ptr<PoolHandle[]> free_;
+    size_t free_count_;
+};
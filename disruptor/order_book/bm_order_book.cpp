@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+#include "order_book_pipeline.h"
+
+#include <memory>
+#include <thread>
+
+constexpr size_t kRingSize = 1 << 14;
+constexpr long kBurst = 4096;
+
+static void report_latencies(benchmark::State& state, SignalGenerator& signal)
+{
+    LatencyRecorder& latencies = signal.latencies();
+    state.counters["p50_ns"] = latencies.percentile_ns(50);
+    state.counters["p99_ns"] = latencies.percentile_ns(99);
+    state.counters["p99.9_ns"] = latencies.percentile_ns(99.9);
+    state.counters["signals"] = signal.buy_signals() + signal.sell_signals();
+}
+
+// Flat out: every iteration publishes a burst and waits for the signal
+// stage to finish it. Latencies here include queueing behind the burst.
+static void BM_OrderBook_Throughput(benchmark::State& state)
+{
+    auto pipeline = std::make_unique<OrderBookPipeline<kRingSize>>();
+    SyntheticFeed feed;
+    pipeline->start();
+
+    long sequence = -1;
+    for (auto _ : state)
+    {
+        for (long i = 0; i < kBurst; ++i)
+        {
+            sequence = publish_next(*pipeline, feed);
+        }
+        while (pipeline->sequence<1>().load(std::memory_order_acquire) != sequence)
+        {
+            std::this_thread::yield();
+        }
+    }
+    pipeline->halt();
+
+    state.SetItemsProcessed(state.iterations() * kBurst);
+    report_latencies(state, pipeline->handler<1>());
+}
+BENCHMARK(BM_OrderBook_Throughput)->UseRealTime();
+
+// One message every state.range(0) ns, so the latencies are the pipeline's
+// own rather than time spent queued behind earlier messages
+static void BM_OrderBook_Paced(benchmark::State& state)
+{
+    auto pipeline = std::make_unique<OrderBookPipeline<kRingSize>>();
+    SyntheticFeed feed;
+    pipeline->start();
+
+    const uint64_t gap = static_cast<uint64_t>(state.range(0)) * tsc_per_milli() / 1'000'000;
+    uint64_t next_tsc = rdtsc();
+    long sequence = -1;
+    for (auto _ : state)
+    {
+        while (rdtsc() < next_tsc)
+        {
+        }
+        next_tsc += gap;
+        sequence = publish_next(*pipeline, feed);
+    }
+    while (pipeline->sequence<1>().load(std::memory_order_acquire) != sequence)
+    {
+        std::this_thread::yield();
+    }
+    pipeline->halt();
+
+    state.SetItemsProcessed(state.iterations());
+    report_latencies(state, pipeline->handler<1>());
+}
+BENCHMARK(BM_OrderBook_Paced)->Arg(1000)->Arg(10000)->UseRealTime();
+
+BENCHMARK_MAIN();
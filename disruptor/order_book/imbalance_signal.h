@@ -0,0 +1,116 @@
+#pragma once
+
+#include "market_data.h"
+#include "tsc.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Tick-to-signal latencies, in TSC cycles
+/*
+    Keeps the last `capacity` samples (a power of two) in a preallocated
+    ring: record() is a store and an increment on the hot path. Percentiles
+    are computed afterwards, once the recording thread has stopped.
+*/
+class LatencyRecorder
+{
+public:
+    explicit LatencyRecorder(size_t capacity = 1 << 20) : samples_(capacity), mask_(capacity - 1) {}
+
+    void record(uint64_t cycles)
+    {
+        samples_[recorded_++ & mask_] = cycles;
+    }
+
+    // Every sample ever recorded, including those since overwritten
+    size_t recorded() const
+    {
+        return recorded_;
+    }
+
+    void clear()
+    {
+        recorded_ = 0;
+    }
+
+    // percentile in [0, 100] over the samples still held; sorts them
+    double percentile_ns(double percentile)
+    {
+        const size_t count = std::min(recorded_, samples_.size());
+        if (count == 0)
+        {
+            return 0.0;
+        }
+        std::sort(samples_.begin(), samples_.begin() + count);
+        const size_t rank = std::min(count - 1, static_cast<size_t>(percentile / 100.0 * count));
+        return tsc_to_nano(samples_[rank]);
+    }
+
+private:
+    std::vector<uint64_t> samples_;
+    size_t mask_;
+    size_t recorded_ = 0;
+};
+
+// Last stage of the pipeline: a book imbalance signal
+/*
+    -   imbalance = (bid shares - ask shares) / (bid shares + ask shares) at
+        the touch. A signal fires when an instrument's imbalance crosses
+        +-kThreshold into the other regime, i.e. once per regime change
+        rather than on every message.
+
+    -   Every message's tick-to-signal latency (feed publish to the signal
+        decision) is recorded, whether it fires a signal or not.
+*/
+class SignalGenerator
+{
+public:
+    static constexpr double kThreshold = 0.6;
+
+    SignalGenerator() : regimes_(kMaxInstruments, 0) {}
+
+    void on_event(MarketEvent& event, long, bool)
+    {
+        const uint32_t total = event.bid_shares + event.ask_shares;
+        if (event.bid_shares != 0 && event.ask_shares != 0)
+        {
+            const double imbalance = (static_cast<double>(event.bid_shares) - event.ask_shares) / total;
+            const int8_t regime = imbalance > kThreshold ? 1 : imbalance < -kThreshold ? -1 : 0;
+
+            int8_t& current = regimes_[event.instrument];
+            if (regime != 0 && regime != current)
+            {
+                regime > 0 ? ++buy_signals_ : ++sell_signals_;
+            }
+            if (regime != 0)
+            {
+                current = regime;
+            }
+        }
+
+        latencies_.record(rdtsc() - event.publish_tsc);
+    }
+
+    uint64_t buy_signals() const
+    {
+        return buy_signals_;
+    }
+
+    uint64_t sell_signals() const
+    {
+        return sell_signals_;
+    }
+
+    LatencyRecorder& latencies()
+    {
+        return latencies_;
+    }
+
+private:
+    static constexpr size_t kMaxInstruments = 1 << 16;
+
+    std::vector<int8_t> regimes_;
+    uint64_t buy_signals_ = 0;
+    uint64_t sell_signals_ = 0;
+    LatencyRecorder latencies_;
+};
@@ -0,0 +1,396 @@
+#pragma once
+
+#include "market_data.h"
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// NASDAQ TotalView-ITCH 5.0 order messages, as found in capture files
+/*
+    -   A capture is a sequence of messages, each prefixed by its length as
+        a 2 byte big endian integer. Every message starts with
+            type (1) stock locate (2) tracking number (2) timestamp (6)
+        all big endian, the timestamp in nanoseconds since midnight.
+
+    -   The order messages are decoded: A and F (add), E and C (executed),
+        X (cancel), D (delete) and U (replace). Everything else (system
+        events, stock directory, trades, imbalances ...) is skipped.
+*/
+namespace itch
+{
+
+constexpr size_t kHeaderSize = 11;
+
+constexpr size_t kAddOrderSize = 36;
+constexpr size_t kAddOrderMpidSize = 40;
+constexpr size_t kOrderExecutedSize = 31;
+constexpr size_t kOrderExecutedPriceSize = 36;
+constexpr size_t kOrderCancelSize = 23;
+constexpr size_t kOrderDeleteSize = 19;
+constexpr size_t kOrderReplaceSize = 35;
+
+inline uint16_t load16(const char* p)
+{
+    uint16_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __builtin_bswap16(value);
+}
+
+inline uint32_t load32(const char* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __builtin_bswap32(value);
+}
+
+inline uint64_t load48(const char* p)
+{
+    return static_cast<uint64_t>(load16(p)) << 32 | load32(p + 2);
+}
+
+inline uint64_t load64(const char* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __builtin_bswap64(value);
+}
+
+inline void store16(char* p, uint16_t value)
+{
+    value = __builtin_bswap16(value);
+    std::memcpy(p, &value, sizeof(value));
+}
+
+inline void store32(char* p, uint32_t value)
+{
+    value = __builtin_bswap32(value);
+    std::memcpy(p, &value, sizeof(value));
+}
+
+inline void store48(char* p, uint64_t value)
+{
+    store16(p, static_cast<uint16_t>(value >> 32));
+    store32(p + 2, static_cast<uint32_t>(value));
+}
+
+inline void store64(char* p, uint64_t value)
+{
+    value = __builtin_bswap64(value);
+    std::memcpy(p, &value, sizeof(value));
+}
+
+} // namespace itch
+
+// A capture file mapped read only. The parser reads it in place.
+class ItchCapture
+{
+public:
+    explicit ItchCapture(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("ItchCapture: cannot open " + path);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("ItchCapture: cannot stat " + path);
+        }
+        size_ = st.st_size;
+
+        if (size_ > 0)
+        {
+            void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("ItchCapture: cannot map " + path);
+            }
+            data_ = static_cast<const char*>(addr);
+            madvise(addr, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    ~ItchCapture()
+    {
+        if (data_)
+        {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    ItchCapture(const ItchCapture&) = delete;
+    ItchCapture& operator=(const ItchCapture&) = delete;
+
+    const char* data() const
+    {
+        return data_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Decodes order messages from a capture straight into ring slots
+/*
+    -   has_next() steps over messages that are not decoded and reports
+        whether an order message is next; the producer only claims a slot
+        once it knows there is something to put in it. decode() then
+        writes that message's fields into the slot and moves on. No message
+        is copied anywhere else first.
+
+    -   A truncated last message ends the capture, as does a message whose
+        length is too short for its type; truncated() tells them apart from
+        a clean end.
+*/
+class ItchParser
+{
+public:
+    ItchParser(const char* data, size_t size) : data_(data), size_(size) {}
+
+    explicit ItchParser(const ItchCapture& capture) : ItchParser(capture.data(), capture.size()) {}
+
+    bool has_next()
+    {
+        while (offset_ + 2 <= size_)
+        {
+            const size_t length = itch::load16(data_ + offset_);
+            if (offset_ + 2 + length > size_ || length < itch::kHeaderSize)
+            {
+                truncated_ = true;
+                offset_ = size_;
+                return false;
+            }
+
+            const char* message = data_ + offset_ + 2;
+            const size_t required = decoded_size(message[0]);
+            if (required != 0)
+            {
+                if (length < required)
+                {
+                    truncated_ = true;
+                    offset_ = size_;
+                    return false;
+                }
+                return true;
+            }
+
+            ++skipped_;
+            offset_ += 2 + length;
+        }
+        return false;
+    }
+
+    // Exchange timestamp of the message has_next() found
+    uint64_t next_timestamp() const
+    {
+        return itch::load48(data_ + offset_ + 2 + 5);
+    }
+
+    // Only after has_next() returned true
+    void decode(MarketEvent& event)
+    {
+        const size_t length = itch::load16(data_ + offset_);
+        const char* message = data_ + offset_ + 2;
+        offset_ += 2 + length;
+        ++decoded_;
+
+        event.instrument = itch::load16(message + 1);
+        event.timestamp_ns = itch::load48(message + 5);
+        const char* body = message + itch::kHeaderSize;
+
+        switch (message[0])
+        {
+        case 'A':
+        case 'F':
+            event.type = MessageType::AddOrder;
+            event.order_id = itch::load64(body);
+            event.side = body[8] == 'B' ? Side::Buy : Side::Sell;
+            event.shares = itch::load32(body + 9);
+            event.price = itch::load32(body + 21);   // after the 8 byte stock symbol
+            break;
+        case 'E':
+        case 'C':
+            event.type = MessageType::OrderExecuted;
+            event.order_id = itch::load64(body);
+            event.shares = itch::load32(body + 8);
+            break;
+        case 'X':
+            event.type = MessageType::OrderCancel;
+            event.order_id = itch::load64(body);
+            event.shares = itch::load32(body + 8);
+            break;
+        case 'D':
+            event.type = MessageType::OrderDelete;
+            event.order_id = itch::load64(body);
+            break;
+        case 'U':
+            event.type = MessageType::OrderReplace;
+            event.order_id = itch::load64(body);
+            event.new_order_id = itch::load64(body + 8);
+            event.shares = itch::load32(body + 16);
+            event.price = itch::load32(body + 20);
+            break;
+        }
+    }
+
+    // Back to the first message, e.g. to replay the capture again
+    void rewind()
+    {
+        offset_ = 0;
+    }
+
+    size_t decoded() const
+    {
+        return decoded_;
+    }
+
+    size_t skipped() const
+    {
+        return skipped_;
+    }
+
+    bool truncated() const
+    {
+        return truncated_;
+    }
+
+private:
+    // 0 for messages that are skipped
+    static size_t decoded_size(char type)
+    {
+        switch (type)
+        {
+        case 'A': return itch::kAddOrderSize;
+        case 'F': return itch::kAddOrderMpidSize;
+        case 'E': return itch::kOrderExecutedSize;
+        case 'C': return itch::kOrderExecutedPriceSize;
+        case 'X': return itch::kOrderCancelSize;
+        case 'D': return itch::kOrderDeleteSize;
+        case 'U': return itch::kOrderReplaceSize;
+        default: return 0;
+        }
+    }
+
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+    size_t decoded_ = 0;
+    size_t skipped_ = 0;
+    bool truncated_ = false;
+};
+
+// Encodes MarketEvents as an ITCH capture, e.g. to record SyntheticFeed
+// as a replayable file. Off the hot path: appends to a std::string.
+class ItchWriter
+{
+public:
+    void write(const MarketEvent& event)
+    {
+        switch (event.type)
+        {
+        case MessageType::AddOrder:
+        {
+            char* body = begin('A', itch::kAddOrderSize, event);
+            itch::store64(body, event.order_id);
+            body[8] = static_cast<char>(event.side);
+            itch::store32(body + 9, event.shares);
+            std::memset(body + 13, ' ', 8);
+            itch::store32(body + 21, event.price);
+            break;
+        }
+        case MessageType::OrderExecuted:
+        {
+            char* body = begin('E', itch::kOrderExecutedSize, event);
+            itch::store64(body, event.order_id);
+            itch::store32(body + 8, event.shares);
+            itch::store64(body + 12, ++match_number_);
+            break;
+        }
+        case MessageType::OrderCancel:
+        {
+            char* body = begin('X', itch::kOrderCancelSize, event);
+            itch::store64(body, event.order_id);
+            itch::store32(body + 8, event.shares);
+            break;
+        }
+        case MessageType::OrderDelete:
+        {
+            char* body = begin('D', itch::kOrderDeleteSize, event);
+            itch::store64(body, event.order_id);
+            break;
+        }
+        case MessageType::OrderReplace:
+        {
+            char* body = begin('U', itch::kOrderReplaceSize, event);
+            itch::store64(body, event.order_id);
+            itch::store64(body + 8, event.new_order_id);
+            itch::store32(body + 16, event.shares);
+            itch::store32(body + 20, event.price);
+            break;
+        }
+        }
+    }
+
+    // A message that is not decoded, e.g. 'S' system event
+    void write_other(char type, size_t length, uint64_t timestamp_ns)
+    {
+        MarketEvent event{};
+        event.timestamp_ns = timestamp_ns;
+        begin(type, length, event);
+    }
+
+    const std::string& data() const
+    {
+        return data_;
+    }
+
+    // Throws std::runtime_error if the file cannot be written
+    void save(const std::string& path) const
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            throw std::runtime_error("ItchWriter: cannot open " + path);
+        }
+        const bool written = ::write(fd, data_.data(), data_.size()) == static_cast<ssize_t>(data_.size());
+        ::close(fd);
+        if (!written)
+        {
+            throw std::runtime_error("ItchWriter: cannot write " + path);
+        }
+    }
+
+private:
+    // Appends the length prefix and header; returns the zeroed body
+    char* begin(char type, size_t length, const MarketEvent& event)
+    {
+        const size_t offset = data_.size();
+        data_.resize(offset + 2 + length);
+        char* p = data_.data() + offset;
+        itch::store16(p, static_cast<uint16_t>(length));
+        p[2] = type;
+        itch::store16(p + 3, event.instrument);
+        itch::store16(p + 5, 0);
+        itch::store48(p + 7, event.timestamp_ns);
+        return p + 2 + itch::kHeaderSize;
+    }
+
+    std::string data_;
+    uint64_t match_number_ = 0;
+};
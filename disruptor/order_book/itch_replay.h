@@ -0,0 +1,78 @@
+#pragma once
+
+#include "itch.h"
+#include "tsc.h"
+#include <cstdint>
+#include <limits>
+
+enum class ReplayMode
+{
+    FlatOut,    // publish every message as soon as a slot is free
+    Recorded,   // keep the capture's own gaps between exchange timestamps
+};
+
+// Replays a capture into a ring: for each order message the parser finds,
+// claim a slot, decode the message straight into it, stamp the tick and
+// publish. Ring is anything with next(), get(sequence) returning a
+// MarketEvent& and publish(sequence), e.g. an OrderBookPipeline.
+/*
+    -   Recorded mode waits (spinning on the TSC) until each message is due
+        relative to the first one, so the ring sees the capture's real
+        bursts and lulls; speed > 1 compresses the gaps. The wait happens
+        before the slot is claimed, so it never holds up consumers. A
+        timestamp earlier than the first one is due at once.
+
+    -   Returns the last sequence published, -1 if there was none. Stops
+        after max_messages or at the end of the capture.
+*/
+template <typename Ring>
+long replay(Ring& ring, ItchParser& parser, ReplayMode mode, double speed = 1.0,
+            size_t max_messages = std::numeric_limits<size_t>::max())
+{
+    const double tsc_per_ns = tsc_per_milli() / 1e6 / speed;
+    long sequence = -1;
+    uint64_t first_timestamp = 0;
+    uint64_t start_tsc = 0;
+
+    for (size_t published = 0; published < max_messages && parser.has_next(); ++published)
+    {
+        if (mode == ReplayMode::Recorded)
+        {
+            const uint64_t timestamp = parser.next_timestamp();
+            if (published == 0)
+            {
+                first_timestamp = timestamp;
+                start_tsc = rdtsc();
+            }
+            // Unsigned: a timestamp that went backwards would wrap to the
+            // far future and spin almost forever
+            const uint64_t offset = timestamp > first_timestamp ? timestamp - first_timestamp : 0;
+            const uint64_t due = start_tsc + static_cast<uint64_t>(offset * tsc_per_ns);
+            while (rdtsc() < due)
+            {
+            }
+        }
+
+        sequence = ring.next();
+        auto& event = ring.get(sequence);
+        parser.decode(event);
+        event.publish_tsc = rdtsc();
+        ring.publish(sequence);
+    }
+    return sequence;
+}
+
+// Record messages of a SyntheticFeed as a capture file, e.g. when no real
+// capture is at hand. Throws std::runtime_error if it cannot be written.
+inline void record_synthetic_capture(const std::string& path, size_t messages, uint16_t instruments = 8)
+{
+    SyntheticFeed feed(instruments);
+    ItchWriter writer;
+    MarketEvent event{};
+    for (size_t i = 0; i < messages; ++i)
+    {
+        feed.next(event);
+        writer.write(event);
+    }
+    writer.save(path);
+}
@@ -0,0 +1,31 @@
+#include "itch_replay.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+// Writes a synthetic ITCH 5.0 capture for replay benchmarks
+/*
+    make_itch_capture <path> [messages] [instruments]
+*/
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <path> [messages] [instruments]\n", argv[0]);
+        return 1;
+    }
+
+    const size_t messages = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1'000'000;
+    const uint16_t instruments = argc > 3 ? static_cast<uint16_t>(std::atoi(argv[3])) : 8;
+    try
+    {
+        record_synthetic_capture(argv[1], messages, instruments);
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Market data as it travels through the order book pipeline
+/*
+    -   The message types are a subset of NASDAQ ITCH 5.0's order messages:
+        add, execute, cancel (partial), delete and replace. Instruments are ITCH
+        stock locates, prices integer ticks of 1/10000, as in ITCH.
+
+    -   A MarketEvent is one ring slot. The feed fills the message fields;
+        each stage then adds its own results to the same slot (the book
+        its top of book, the signal stage nothing, it only reads), so no
+        stage ever copies a message or allocates.
+*/
+enum class MessageType : char
+{
+    AddOrder = 'A',
+    OrderExecuted = 'E',
+    OrderCancel = 'X',
+    OrderDelete = 'D',
+    OrderReplace = 'U',
+};
+
+enum class Side : char
+{
+    Buy = 'B',
+    Sell = 'S',
+};
+
+struct MarketEvent
+{
+    // Filled by the feed
+    MessageType type;
+    Side side;                 // AddOrder only
+    uint16_t instrument;
+    uint32_t shares;           // added, executed or cancelled
+    uint32_t price;            // AddOrder and OrderReplace
+    uint64_t order_id;         // the replaced order for OrderReplace
+    uint64_t new_order_id;     // OrderReplace only
+    uint64_t timestamp_ns;     // exchange time, nanoseconds since midnight
+    uint64_t publish_tsc;      // when the feed published it: the tick
+
+    // Filled by the book: its instrument's top of book after the message
+    uint32_t bid_price;
+    uint32_t bid_shares;
+    uint32_t ask_price;
+    uint32_t ask_shares;
+};
+
+// Generates a valid ITCH-like order flow: orders are only executed,
+// cancelled or deleted while they rest, and never for more shares than
+// they have left. Deterministic for a given seed.
+/*
+    Prices stay within kPriceBand ticks of each instrument's mid, which
+    drifts by a tick at a time, so the book sees a realistic mix of touches
+    and deep levels.
+*/
+class SyntheticFeed
+{
+public:
+    static constexpr uint32_t kPriceBand = 64;
+
+    explicit SyntheticFeed(uint16_t instruments = 8, uint64_t seed = 42)
+        : random_(seed), mids_(instruments, 100 * 10000)
+    {
+        live_.reserve(kMaxLiveOrders);
+    }
+
+    // Write the next message into event in place
+    void next(MarketEvent& event)
+    {
+        timestamp_ns_ += 1 + random_() % 1000;
+        event.timestamp_ns = timestamp_ns_;
+
+        const uint64_t action = random_() % 100;
+        if (live_.size() < kMinLiveOrders || (action < 50 && live_.size() < kMaxLiveOrders))
+        {
+            add(event);
+        }
+        else if (action < 70)
+        {
+            execute(event);
+        }
+        else if (action < 85)
+        {
+            cancel(event);
+        }
+        else if (action < 90)
+        {
+            replace(event);
+        }
+        else
+        {
+            remove(event);
+        }
+    }
+
+private:
+    static constexpr size_t kMinLiveOrders = 256;
+    static constexpr size_t kMaxLiveOrders = 1 << 16;
+
+    struct LiveOrder
+    {
+        uint64_t order_id;
+        uint16_t instrument;
+        Side side;
+        uint32_t shares;
+    };
+
+    void add(MarketEvent& event)
+    {
+        const uint16_t instrument = static_cast<uint16_t>(random_() % mids_.size());
+        uint32_t& mid = mids_[instrument];
+        mid += static_cast<uint32_t>(random_() % 3) - 1;
+
+        const Side side = random_() % 2 ? Side::Buy : Side::Sell;
+
+        event.type = MessageType::AddOrder;
+        event.side = side;
+        event.instrument = instrument;
+        event.shares = random_shares();
+        event.price = random_price(mid, side);
+        event.order_id = ++last_order_id_;
+
+        live_.push_back(LiveOrder{event.order_id, instrument, side, event.shares});
+    }
+
+    // Same side and instrument, new id, price and size
+    void replace(MarketEvent& event)
+    {
+        LiveOrder& order = pick();
+        fill(event, MessageType::OrderReplace, order, random_shares());
+        event.new_order_id = ++last_order_id_;
+        event.price = random_price(mids_[order.instrument], order.side);
+
+        order.order_id = event.new_order_id;
+        order.shares = event.shares;
+    }
+
+    uint32_t random_shares()
+    {
+        return 100 * (1 + static_cast<uint32_t>(random_() % 10));
+    }
+
+    uint32_t random_price(uint32_t mid, Side side)
+    {
+        const uint32_t offset = 1 + static_cast<uint32_t>(random_() % kPriceBand);
+        return side == Side::Buy ? mid - offset : mid + offset;
+    }
+
+    void execute(MarketEvent& event)
+    {
+        LiveOrder& order = pick();
+        const uint32_t shares = std::min<uint32_t>(order.shares, 100);
+        fill(event, MessageType::OrderExecuted, order, shares);
+        reduce(order, shares);
+    }
+
+    void cancel(MarketEvent& event)
+    {
+        LiveOrder& order = pick();
+        const uint32_t shares = 1 + static_cast<uint32_t>(random_() % order.shares);
+        fill(event, MessageType::OrderCancel, order, shares);
+        reduce(order, shares);
+    }
+
+    void remove(MarketEvent& event)
+    {
+        LiveOrder& order = pick();
+        fill(event, MessageType::OrderDelete, order, order.shares);
+        reduce(order, order.shares);
+    }
+
+    LiveOrder& pick()
+    {
+        return live_[random_() % live_.size()];
+    }
+
+    static void fill(MarketEvent& event, MessageType type, const LiveOrder& order, uint32_t shares)
+    {
+        event.type = type;
+        event.instrument = order.instrument;
+        event.shares = shares;
+        event.order_id = order.order_id;
+    }
+
+    // Drops the picked order once it has no shares left
+    void reduce(LiveOrder& order, uint32_t shares)
+    {
+        order.shares -= shares;
+        if (order.shares == 0)
+        {
+            order = live_.back();
+            live_.pop_back();
+        }
+    }
+
+    std::mt19937_64 random_;
+    std::vector<uint32_t> mids_;
+    std::vector<LiveOrder> live_;
+    uint64_t last_order_id_ = 0;
+    uint64_t timestamp_ns_ = 0;
+};
@@ -0,0 +1,449 @@
+#pragma once
+
+#include "market_data.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Resting orders by order id, for every instrument
+/*
+    -   Execute, cancel and delete messages only carry an order id, so the
+        book has to find the order's instrument, side and price. An open
+        addressing table with linear probing: one cache line usually holds
+        the whole probe, and a delete shifts the following entries back
+        instead of leaving tombstones, so probes stay short however long
+        the session runs.
+
+    -   Capacity is a power of two. Sized at least twice the most orders
+        ever resting at once, the table never allocates after construction;
+        past half full it doubles and rehashes, a one-off stall, rather
+        than let probes grow until a full table spins forever.
+*/
+class OrderTable
+{
+public:
+    struct Order
+    {
+        uint64_t order_id;     // 0: empty
+        uint32_t price;
+        uint32_t shares;
+        uint16_t instrument;
+        Side side;
+    };
+
+    // Throws std::invalid_argument unless capacity is a power of two
+    explicit OrderTable(size_t capacity = 1 << 18)
+        : orders_(capacity), mask_(capacity - 1)
+    {
+        if (capacity < 2 || (capacity & mask_) != 0)
+        {
+            throw std::invalid_argument("OrderTable: capacity must be a power of two");
+        }
+    }
+
+    // Invalidates the pointers find() returned
+    void insert(const Order& order)
+    {
+        if (2 * (size_ + 1) > orders_.size()) [[unlikely]]
+        {
+            grow();
+        }
+        place(order);
+        ++size_;
+    }
+
+    // nullptr if the order is unknown
+    Order* find(uint64_t order_id)
+    {
+        for (size_t i = slot(order_id); orders_[i].order_id != 0; i = (i + 1) & mask_)
+        {
+            if (orders_[i].order_id == order_id)
+            {
+                return &orders_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // order must come from find()
+    void erase(Order* order)
+    {
+        size_t hole = order - orders_.data();
+        for (size_t i = (hole + 1) & mask_; orders_[i].order_id != 0; i = (i + 1) & mask_)
+        {
+            // Move the entry back into the hole unless its home slot lies
+            // cyclically in (hole, i]
+            const size_t home = slot(orders_[i].order_id);
+            if (((i - home) & mask_) >= ((i - hole) & mask_))
+            {
+                orders_[hole] = orders_[i];
+                hole = i;
+            }
+        }
+        orders_[hole].order_id = 0;
+        --size_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    size_t capacity() const
+    {
+        return orders_.size();
+    }
+
+private:
+    void place(const Order& order)
+    {
+        size_t i = slot(order.order_id);
+        while (orders_[i].order_id != 0)
+        {
+            i = (i + 1) & mask_;
+        }
+        orders_[i] = order;
+    }
+
+    __attribute__((noinline))
+    void grow()
+    {
+        std::vector<Order> old(2 * orders_.size());
+        old.swap(orders_);
+        mask_ = orders_.size() - 1;
+        for (const Order& order : old)
+        {
+            if (order.order_id != 0)
+            {
+                place(order);
+            }
+        }
+    }
+
+    size_t slot(uint64_t order_id) const
+    {
+        // Fibonacci hashing: ids arrive sequentially, spread them out
+        return (order_id * 0x9E3779B97F4A7C15ull >> 20) & mask_;
+    }
+
+    std::vector<Order> orders_;
+    size_t mask_;
+    size_t size_ = 0;
+};
+
+// Aggregated shares per price level of one instrument
+/*
+    -   Each side is a price ladder: an array of kLevels levels starting at
+        a base price, indexed by price - base. Adding to or reducing a
+        level is a single array update; the best level moves by scanning,
+        and only when the best level empties.
+
+    -   Levels outside the ladder's window rest in a std::map per side, so
+        every level is always in exactly one of the two and the top of book
+        is right wherever prices go. out_of_range() counts the adds that
+        went to the maps: far away quotes mostly, which the maps hold
+        without touching the ladder.
+
+    -   The window starts centred on the instrument's first price. When an
+        add outside it would become the best price of its side, i.e. the
+        touch has moved away, the ladder is recentred on it: every level
+        moves to the maps and the ones inside the new window come back, a
+        scan of the ladder that recenters() counts.
+*/
+class OrderBook
+{
+public:
+    static constexpr uint32_t kLevels = 4096;
+
+    struct Top
+    {
+        uint32_t bid_price;
+        uint32_t bid_shares;
+        uint32_t ask_price;
+        uint32_t ask_shares;
+    };
+
+    explicit OrderBook(uint32_t first_price) : base_(centred(first_price)) {}
+
+    void add(Side side, uint32_t price, uint32_t shares)
+    {
+        uint32_t level;
+        if (!index(price, level))
+        {
+            if (!improves(side, price))
+            {
+                ++out_of_range_;
+                (side == Side::Buy ? outside_bids_ : outside_asks_)[price] += shares;
+                return;
+            }
+            recentre(price);
+            index(price, level);
+        }
+
+        if (side == Side::Buy)
+        {
+            bids_[level] += shares;
+            if (best_bid_ == kNone || level > best_bid_)
+            {
+                best_bid_ = level;
+            }
+        }
+        else
+        {
+            asks_[level] += shares;
+            if (best_ask_ == kNone || level < best_ask_)
+            {
+                best_ask_ = level;
+            }
+        }
+    }
+
+    void reduce(Side side, uint32_t price, uint32_t shares)
+    {
+        uint32_t level;
+        if (!index(price, level))
+        {
+            std::map<uint32_t, uint32_t>& levels = side == Side::Buy ? outside_bids_ : outside_asks_;
+            auto it = levels.find(price);
+            if (it != levels.end() && (it->second -= std::min(shares, it->second)) == 0)
+            {
+                levels.erase(it);
+            }
+            return;
+        }
+
+        if (side == Side::Buy)
+        {
+            bids_[level] -= shares;
+            if (bids_[level] == 0 && level == best_bid_)
+            {
+                while (best_bid_ != kNone && bids_[best_bid_] == 0)
+                {
+                    best_bid_ = best_bid_ == 0 ? kNone : best_bid_ - 1;
+                }
+            }
+        }
+        else
+        {
+            asks_[level] -= shares;
+            if (asks_[level] == 0 && level == best_ask_)
+            {
+                while (best_ask_ != kNone && asks_[best_ask_] == 0)
+                {
+                    best_ask_ = best_ask_ + 1 == kLevels ? kNone : best_ask_ + 1;
+                }
+            }
+        }
+    }
+
+    // Price and shares of 0 for an empty side
+    Top top() const
+    {
+        Top top{};
+        if (best_bid_ != kNone)
+        {
+            top.bid_price = base_ + best_bid_;
+            top.bid_shares = bids_[best_bid_];
+        }
+        if (!outside_bids_.empty() && (top.bid_shares == 0 || outside_bids_.rbegin()->first > top.bid_price))
+        {
+            top.bid_price = outside_bids_.rbegin()->first;
+            top.bid_shares = outside_bids_.rbegin()->second;
+        }
+
+        if (best_ask_ != kNone)
+        {
+            top.ask_price = base_ + best_ask_;
+            top.ask_shares = asks_[best_ask_];
+        }
+        if (!outside_asks_.empty() && (top.ask_shares == 0 || outside_asks_.begin()->first < top.ask_price))
+        {
+            top.ask_price = outside_asks_.begin()->first;
+            top.ask_shares = outside_asks_.begin()->second;
+        }
+        return top;
+    }
+
+    uint64_t out_of_range() const
+    {
+        return out_of_range_;
+    }
+
+    uint64_t recenters() const
+    {
+        return recenters_;
+    }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    static uint32_t centred(uint32_t price)
+    {
+        return price > kLevels / 2 ? price - kLevels / 2 : 0;
+    }
+
+    bool index(uint32_t price, uint32_t& level) const
+    {
+        level = price - base_;
+        return price >= base_ && level < kLevels;
+    }
+
+    // Would price be the best of its side?
+    bool improves(Side side, uint32_t price) const
+    {
+        const Top current = top();
+        return side == Side::Buy ? current.bid_shares == 0 || price > current.bid_price
+                                 : current.ask_shares == 0 || price < current.ask_price;
+    }
+
+    __attribute__((noinline))
+    void recentre(uint32_t price)
+    {
+        ++recenters_;
+        for (uint32_t level = 0; level < kLevels; ++level)
+        {
+            if (bids_[level] != 0)
+            {
+                outside_bids_[base_ + level] += bids_[level];
+            }
+            if (asks_[level] != 0)
+            {
+                outside_asks_[base_ + level] += asks_[level];
+            }
+        }
+
+        base_ = centred(price);
+        bring_inside(outside_bids_, bids_);
+        bring_inside(outside_asks_, asks_);
+
+        best_bid_ = kNone;
+        for (uint32_t level = kLevels; level-- > 0;)
+        {
+            if (bids_[level] != 0)
+            {
+                best_bid_ = level;
+                break;
+            }
+        }
+        best_ask_ = kNone;
+        for (uint32_t level = 0; level < kLevels; ++level)
+        {
+            if (asks_[level] != 0)
+            {
+                best_ask_ = level;
+                break;
+            }
+        }
+    }
+
+    // Moves the levels inside the window from outside into the ladder
+    void bring_inside(std::map<uint32_t, uint32_t>& outside, std::array<uint32_t, kLevels>& ladder)
+    {
+        ladder.fill(0);
+        auto first = outside.lower_bound(base_);
+        auto last = outside.lower_bound(base_ + kLevels);
+        for (auto it = first; it != last; ++it)
+        {
+            ladder[it->first - base_] = it->second;
+        }
+        outside.erase(first, last);
+    }
+
+    uint32_t base_;
+    uint32_t best_bid_ = kNone;
+    uint32_t best_ask_ = kNone;
+    uint64_t out_of_range_ = 0;
+    uint64_t recenters_ = 0;
+    std::array<uint32_t, kLevels> bids_{};
+    std::array<uint32_t, kLevels> asks_{};
+    std::map<uint32_t, uint32_t> outside_bids_;
+    std::map<uint32_t, uint32_t> outside_asks_;
+};
+
+// First stage of the pipeline: applies each message to its instrument's
+// book and writes the resulting top of book into the event.
+/*
+    A book is allocated the first time its instrument adds an order, i.e.
+    while the feed warms up; after that the stage only allocates for
+    levels outside a ladder's window and when the OrderTable grows.
+    Messages for unknown orders (e.g. a capture joined mid-session) are
+    counted and skipped, with an empty top of book.
+*/
+class BookBuilder
+{
+public:
+    // One entry per possible ITCH stock locate
+    static constexpr size_t kMaxInstruments = 1 << 16;
+
+    BookBuilder() : books_(kMaxInstruments) {}
+
+    void on_event(MarketEvent& event, long, bool)
+    {
+        std::unique_ptr<OrderBook>& book = books_[event.instrument];
+
+        if (event.type == MessageType::AddOrder)
+        {
+            if (!book)
+            {
+                book = std::make_unique<OrderBook>(event.price);
+            }
+            book->add(event.side, event.price, event.shares);
+            orders_.insert(OrderTable::Order{event.order_id, event.price, event.shares, event.instrument, event.side});
+        }
+        else
+        {
+            OrderTable::Order* order = orders_.find(event.order_id);
+            if (order == nullptr || !book)
+            {
+                ++unknown_orders_;
+                event.bid_price = event.bid_shares = event.ask_price = event.ask_shares = 0;
+                return;
+            }
+
+            if (event.type == MessageType::OrderReplace)
+            {
+                // Loses its place in the queue: the old order goes, a new one rests
+                const OrderTable::Order replaced = *order;
+                book->reduce(replaced.side, replaced.price, replaced.shares);
+                orders_.erase(order);
+                book->add(replaced.side, event.price, event.shares);
+                orders_.insert(OrderTable::Order{event.new_order_id, event.price, event.shares, replaced.instrument, replaced.side});
+            }
+            else
+            {
+                const uint32_t shares = event.type == MessageType::OrderDelete ? order->shares : std::min(event.shares, order->shares);
+                book->reduce(order->side, order->price, shares);
+                order->shares -= shares;
+                if (order->shares == 0)
+                {
+                    orders_.erase(order);
+                }
+            }
+        }
+
+        const OrderBook::Top top = book->top();
+        event.bid_price = top.bid_price;
+        event.bid_shares = top.bid_shares;
+        event.ask_price = top.ask_price;
+        event.ask_shares = top.ask_shares;
+    }
+
+    const OrderBook* book(uint16_t instrument) const
+    {
+        return books_[instrument].get();
+    }
+
+    uint64_t unknown_orders() const
+    {
+        return unknown_orders_;
+    }
+
+private:
+    std::vector<std::unique_ptr<OrderBook>> books_;
+    OrderTable orders_;
+    uint64_t unknown_orders_ = 0;
+};
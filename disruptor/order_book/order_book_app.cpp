@@ -0,0 +1,58 @@
+#include "order_book_pipeline.h"
+#include "thread_affinity.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+// Reference application: a synthetic ITCH-like feed through a book
+// builder into an imbalance signal, each stage on its own pinned thread.
+/*
+    order_book_app [messages] [feed_cpu book_cpu signal_cpu]
+
+    Without CPUs the threads are not pinned. Prints the throughput, the
+    signals fired and the tick-to-signal latency percentiles.
+*/
+int main(int argc, char** argv)
+{
+    const long messages = argc > 1 ? std::atol(argv[1]) : 10'000'000;
+    std::vector<int> cpus;
+    for (int i = 2; i < argc && i < 5; ++i)
+    {
+        cpus.push_back(std::atoi(argv[i]));
+    }
+
+    auto pipeline = std::make_unique<OrderBookPipeline<1 << 14>>();
+    SyntheticFeed feed;
+
+    if (!cpus.empty() && !pin_current_thread(cpus[0]))
+    {
+        std::fprintf(stderr, "cannot pin the feed to cpu %d\n", cpus[0]);
+    }
+    pipeline->start(cpus.size() > 1 ? std::vector<int>(cpus.begin() + 1, cpus.end()) : std::vector<int>{});
+
+    const auto start = std::chrono::steady_clock::now();
+    long sequence = -1;
+    for (long i = 0; i < messages; ++i)
+    {
+        sequence = publish_next(*pipeline, feed);
+    }
+    while (pipeline->sequence<1>().load(std::memory_order_acquire) != sequence)
+    {
+        std::this_thread::yield();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    pipeline->halt();
+
+    SignalGenerator& signal = pipeline->handler<1>();
+    LatencyRecorder& latencies = signal.latencies();
+    std::printf("messages=%ld msgs_per_sec=%.0f buy_signals=%lu sell_signals=%lu unknown_orders=%lu\n",
+                messages, messages / elapsed.count(), signal.buy_signals(), signal.sell_signals(),
+                pipeline->handler<0>().unknown_orders());
+    std::printf("tick_to_signal_ns p50=%.0f p99=%.0f p99.9=%.0f max=%.0f\n",
+                latencies.percentile_ns(50), latencies.percentile_ns(99), latencies.percentile_ns(99.9),
+                latencies.percentile_ns(100));
+    return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "imbalance_signal.h"
+#include "market_data.h"
+#include "order_book.h"
+#include "pipeline.h"
+#include "tsc.h"
+#include "yield_wait_strategy.h"
+
+// Feed -> book -> signal, one thread per stage
+template <size_t N, typename WaitStrategyDerived = YieldWaitStrategy>
+using OrderBookPipeline = Pipeline<MarketEvent, N, WaitStrategyDerived, Stage<BookBuilder>, Stage<SignalGenerator>>;
+
+// Write the feed's next message straight into the claimed slot and stamp
+// the tick. Returns the published sequence.
+template <typename PipelineT>
+long publish_next(PipelineT& pipeline, SyntheticFeed& feed)
+{
+    const long sequence = pipeline.next();
+    MarketEvent& event = pipeline.get(sequence);
+    feed.next(event);
+    event.publish_tsc = rdtsc();
+    pipeline.publish(sequence);
+    return sequence;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+// Hardware counters via perf_event_open(2).
+/*
+    -   Counters are opened with inherit = 1 on the calling thread, so every
+        thread spawned after start() is counted as well. Their counts are
+        folded into ours when they exit, i.e. join the workers before stop().
+
+    -   On machines (or containers) where perf_event_paranoid forbids it,
+        available() is false and every value reads as zero.
+
+    -   Coherency traffic has no portable event. L1D load misses and LLC
+        references/misses are the closest generic proxies: a cache line the
+        other core keeps writing shows up as an L1D miss that is served from
+        another core's cache.
+*/
+class PerfCounters
+{
+public:
+    enum Counter { kCycles, kInstructions, kL1DLoadMisses, kLLCReferences, kLLCMisses, kNumCounters };
+
+    static constexpr std::array<const char*, kNumCounters> kNames = {
+        "cycles", "instructions", "L1D-load-misses", "LLC-references", "LLC-misses"
+    };
+
+    PerfCounters()
+    {
+        fds_.fill(-1);
+        open(kCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(kInstructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(kL1DLoadMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        open(kLLCReferences, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+        open(kLLCMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    }
+
+    ~PerfCounters()
+    {
+        for (int fd : fds_)
+        {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return fds_[kCycles] >= 0; }
+    bool available(Counter counter) const { return fds_[counter] >= 0; }
+
+    void start()
+    {
+        for (int fd : fds_)
+        {
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop()
+    {
+        for (int fd : fds_)
+        {
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    // Accumulated since construction (counters are never reset)
+    uint64_t value(Counter counter) const
+    {
+        uint64_t value = 0;
+        if (fds_[counter] < 0 || read(fds_[counter], &value, sizeof(value)) != sizeof(value))
+        {
+            return 0;
+        }
+        return value;
+    }
+
+private:
+    void open(Counter counter, uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fds_[counter] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    std::array<int, kNumCounters> fds_;
+};
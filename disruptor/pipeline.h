@@ -0,0 +1,241 @@
+#pragma once
+
+#include "sequencer.h"
+#include "thread_affinity.h"
+#include "yield_wait_strategy.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// A consumer graph expressed as a type
+/*
+        Pipeline<Event, 1024, YieldWaitStrategy, Stage<A>, Parallel<B, C>, Stage<D>>
+
+    -   Each Stage<H> / Parallel<H...> is one step of the graph. Every
+        handler of step i waits for all handlers of step i - 1 (the first
+        step for the producer's cursor), and the producer gates on the
+        handlers of the last step.
+
+    -   Handlers are held by value and called directly through their type:
+        no EventHandler vtable, no shared_ptr, no std::vector of processors.
+        Every barrier is a fold over a std::tuple known at compile time, so
+        the compiler can inline on_event() and unroll the min over upstream
+        sequences.
+
+    -   A handler is any type with
+            void on_event(EventT& event, long sequence, bool end_of_batch);
+        default constructed by the pipeline and reachable through handler<>().
+
+    -   Each handler runs on its own thread, one thread per core as with
+        EventProcessor; start() can pin them. The pipeline has a single
+        producer.
+*/
+template <typename Handler>
+struct Stage {};
+
+template <typename... Handlers>
+struct Parallel {};
+
+namespace pipeline_detail
+{
+
+template <typename Handler>
+struct Slot
+{
+    Handler handler;
+    Sequence sequence;
+};
+
+template <typename StageT>
+struct Step;
+
+template <typename Handler>
+struct Step<Stage<Handler>>
+{
+    std::tuple<Slot<Handler>> slots;
+};
+
+template <typename... Handlers>
+struct Step<Parallel<Handlers...>>
+{
+    std::tuple<Slot<Handlers>...> slots;
+};
+
+template <typename... Slots>
+inline long minimum_sequence(const std::tuple<Slots...>& slots, long minimum)
+{
+    std::apply([&minimum](const auto&... slot) {
+        ((minimum = std::min(minimum, slot.sequence.value.load(std::memory_order_acquire))), ...);
+    }, slots);
+    return minimum;
+}
+
+} // namespace pipeline_detail
+
+template <typename EventT, size_t N, typename WaitStrategyDerived, typename... Stages>
+class Pipeline
+{
+    static_assert(N > 0 && ((N & (N - 1)) == 0), "Pipeline requires N to be a power of two");
+    static_assert(sizeof...(Stages) > 0, "Pipeline requires at least one stage");
+
+    using Steps = std::tuple<pipeline_detail::Step<Stages>...>;
+    static constexpr size_t kNumSteps = sizeof...(Stages);
+
+public:
+    Pipeline()
+    {
+        if constexpr (WaitStrategyDerived::kBlocking)
+        {
+            sequencer_.enable_blocking_wait();
+        }
+    }
+
+    ~Pipeline()
+    {
+        halt();
+    }
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    // Producer side: claim, fill get(sequence), publish
+    long next()
+    {
+        const long sequence = sequencer_.next();
+        const long wrap_point = sequence - static_cast<long>(N);
+
+        if (wrap_point > cached_gating_)
+        {
+            long min_sequence;
+            while (wrap_point > (min_sequence = pipeline_detail::minimum_sequence(std::get<kNumSteps - 1>(steps_).slots, sequence - 1)))
+            {
+                std::this_thread::yield();
+            }
+            cached_gating_ = min_sequence;
+        }
+        return sequence;
+    }
+
+    EventT& get(long sequence)
+    {
+        return ring_[sequence & (N - 1)];
+    }
+
+    void publish(long sequence)
+    {
+        sequencer_.publish(sequence);
+    }
+
+    long cursor() const
+    {
+        return sequencer_.cursor();
+    }
+
+    // cpus[i] is the CPU of the i-th handler in declaration order; handlers
+    // past the end of cpus, or whose CPU cannot be used, are not pinned.
+    void start(std::vector<int> cpus = {})
+    {
+        running_.store(true, std::memory_order_relaxed);
+        cpus_ = std::move(cpus);
+        start_steps(std::make_index_sequence<kNumSteps>{});
+    }
+
+    void halt()
+    {
+        running_.store(false, std::memory_order_relaxed);
+        sequencer_.wake_waiters();
+        for (auto& thread : threads_)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+        threads_.clear();
+    }
+
+    template <size_t StepIndex, size_t HandlerIndex = 0>
+    auto& handler()
+    {
+        return std::get<HandlerIndex>(std::get<StepIndex>(steps_).slots).handler;
+    }
+
+    // The last sequence that handler has finished with
+    template <size_t StepIndex, size_t HandlerIndex = 0>
+    const std::atomic<long>& sequence() const
+    {
+        return std::get<HandlerIndex>(std::get<StepIndex>(steps_).slots).sequence.value;
+    }
+
+private:
+    template <size_t... StepIndices>
+    void start_steps(std::index_sequence<StepIndices...>)
+    {
+        (start_handlers<StepIndices>(std::make_index_sequence<std::tuple_size_v<decltype(std::get<StepIndices>(steps_).slots)>>{}), ...);
+    }
+
+    template <size_t StepIndex, size_t... HandlerIndices>
+    void start_handlers(std::index_sequence<HandlerIndices...>)
+    {
+        (threads_.emplace_back([this, cpu = cpu_of(threads_.size())]() {
+            pin_current_thread(cpu);
+            run<StepIndex, HandlerIndices>();
+        }), ...);
+    }
+
+    int cpu_of(size_t thread_index) const
+    {
+        return thread_index < cpus_.size() ? cpus_[thread_index] : -1;
+    }
+
+    // What the handlers of StepIndex may consume up to
+    template <size_t StepIndex>
+    long barrier() const
+    {
+        if constexpr (StepIndex == 0)
+        {
+            return sequencer_.cursor();
+        }
+        else
+        {
+            return pipeline_detail::minimum_sequence(std::get<StepIndex - 1>(steps_).slots, std::numeric_limits<long>::max());
+        }
+    }
+
+    template <size_t StepIndex, size_t HandlerIndex>
+    void run()
+    {
+        auto& slot = std::get<HandlerIndex>(std::get<StepIndex>(steps_).slots);
+        WaitStrategyDerived wait_strategy;
+        long next_sequence = slot.sequence.value.load(std::memory_order_relaxed) + 1;
+
+        while (running_.load(std::memory_order_relaxed))
+        {
+            const long available_sequence = barrier<StepIndex>();
+            if (available_sequence < next_sequence)
+            {
+                wait_strategy.wait_for(next_sequence, sequencer_, running_, [this]() { return barrier<StepIndex>(); });
+                continue;
+            }
+
+            for (; next_sequence <= available_sequence; ++next_sequence)
+            {
+                slot.handler.on_event(ring_[next_sequence & (N - 1)], next_sequence, next_sequence == available_sequence);
+            }
+            slot.sequence.value.store(available_sequence, std::memory_order_release);
+        }
+    }
+
+    Sequencer sequencer_;  // cursor and parking only; next() gates on the last step itself
+    long cached_gating_ = -1;
+    std::atomic<bool> running_{false};
+    Steps steps_;
+    alignas(kCacheLineSize) std::array<EventT, N> ring_;
+    std::vector<int> cpus_;
+    std::vector<std::thread> threads_;
+};
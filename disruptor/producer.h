@@ -1,8 +1,12 @@
 #pragma once
 
+#include "object_pool.h"
+#include "logger.h"
 #include "sequencer.h"
 #include "ring_buffer.h"
+#include "tracer.h"
 #include <iostream>
+#include <string_view>
 
 template <size_t N>
 class Producer
@@ -14,14 +18,53 @@ public:
         std::cout << "Producer Sequencer Addr: " << sequencer_.get() << std::endl;   
     }
 
-    void on_data(const std::string& data)
+    void on_data(std::string_view data)
     {
+        long sequence = publish(data);
+
+        default_logger().log("[Producer] Published: {} at sequence: {}", data, sequence);
+    }
+
+    // Claim a slot, fill it and publish it. Returns the published sequence.
+    long publish(std::string_view data)
+    {
+        long sequence = sequencer_->next();
+        Event& event = ring_buffer_->get(sequence);
+        if (!event.set(data)) [[unlikely]]
+        {
+            sequencer_->metrics().truncations.add();
+        }
+        stamp_publish(sequence);
+        sequencer_->publish(sequence);
+        return sequence;
+    }
+
+    // Publish an object filled in pool, handing it to the consumers without
+    // copying it. The handle the claimed slot held before goes back to the
+    // pool: every consumer has passed that sequence once next() returns.
+    // A ring publishes either this way or by value, never both.
+    template <typename T, size_t Capacity>
+    long publish(ObjectPool<T, Capacity>& pool, PoolHandle handle)
+    {
+        static_assert(Capacity > N, "ObjectPool must hold more objects than the ring has slots");
+
         long sequence = sequencer_->next();
         Event& event = ring_buffer_->get(sequence);
-        event.set(data);
+        if (event.handle() != kNoPoolHandle)
+        {
+            pool.release(event.handle());
+        }
+        event.set_handle(handle);
+        stamp_publish(sequence);
         sequencer_->publish(sequence);
+        return sequence;
+    }
 
-        std::cout << "[Producer] Published: " << data << " at sequence: " << sequence << "\n";
+    // Stamp the publish TSC of every sampled sequence into headers, which
+    // must outlive the producer's use of it
+    void enable_tracing(TraceHeaders& headers)
+    {
+        trace_headers_ = &headers;
     }
 
     void set_sequencer(std::shared_ptr<Sequencer> sequencer)
@@ -31,6 +74,15 @@ public:
     }
 
 private:
+    void stamp_publish(long sequence)
+    {
+        if (trace_headers_ != nullptr && trace_headers_->sampled(sequence)) [[unlikely]]
+        {
+            (*trace_headers_)[sequence].publish_tsc = rdtsc();
+        }
+    }
+
     std::shared_ptr<RingBuffer<N>> ring_buffer_;
     std::shared_ptr<Sequencer> sequencer_;
+    TraceHeaders* trace_headers_ = nullptr;
 };
@@ -16,7 +16,7 @@ public:
 
     Event& get(long sequence)
     {
-        return buffer_[sequence & N];
+        return buffer_[sequence & (N - 1)];
     }
 
     long next() 
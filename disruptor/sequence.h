@@ -0,0 +1,13 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+constexpr size_t kCacheLineSize = 64;
+
+// A sequence counter that lives on its own cache line, so the thread that
+// publishes it never false-shares with whoever polls its neighbours.
+struct alignas(kCacheLineSize) Sequence
+{
+    std::atomic<long> value{-1};
+};
@@ -1,28 +1,222 @@
 #pragma once
 
+#include "metrics.h"
+#include "sequence.h"
+#include "tsc.h"
 #include <atomic>
-#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+// Single producer sequencer.
+/*
+    -   next() only touches producer private state (next_, cached_gating_), so
+        claiming a slot costs no coherency traffic unless the producer is about
+        to wrap around a consumer.
+
+    -   publish() is a release store and cursor() an acquire load. That is
+        all the ordering the ring needs: everything the producer wrote into
+        the slot happens-before the consumer that observes the new cursor.
+        The default seq_cst store would emit an extra full fence (xchg/mfence
+        on x86) on every publish for no benefit.
+
+    -   The set of gating sequences can change while the producer runs. It is
+        an immutable array swapped in with a single atomic pointer store, so
+        the producer never takes a lock: it just loads the pointer when it
+        has to re-check the consumers. Replaced arrays are kept until the
+        Sequencer dies, because the producer may still be scanning one; they
+        are a few pointers each and consumers come and go rarely.
+
+    -   Consumers of a blocking ring park in wait_for_publish(). They sleep on
+        a 32 bit wake epoch rather than on the cursor itself: libstdc++ only
+        maps 32 bit atomics straight onto a futex, and a halt has to be able
+        to wake them without publishing anything.
+*/
 class Sequencer
 {
 public:
-    Sequencer() : cursor_(-1){
+    explicit Sequencer(long buffer_size = std::numeric_limits<long>::max())
+        : buffer_size_(buffer_size), next_(-1), cached_gating_(-1)
+    {
+        gating_sets_.push_back(std::make_unique<GatingSequences>());
+        gating_sequences_.store(gating_sets_.back().get(), std::memory_order_release);
     }
-    
+
+    // Claim the next slot. Waits while the slot still holds an event that
+    // one of the gating sequences has not consumed yet.
     long next()
     {
-        return ++cursor_;
+        long next = ++next_;
+        long wrap_point = next - buffer_size_;
+
+        if (wrap_point > cached_gating_)
+        {
+            long min_sequence = minimum_gating_sequence(next - 1);
+            if (wrap_point > min_sequence)
+            {
+                // Gated: only now is it worth reading the TSC
+                const uint64_t stall_start = rdtsc();
+                do
+                {
+                    std::this_thread::yield();
+                }
+                while (wrap_point > (min_sequence = minimum_gating_sequence(next - 1)));
+
+                metrics_.stalls.add();
+                metrics_.stall_cycles.add(rdtsc() - stall_start);
+            }
+            cached_gating_ = min_sequence;
+        }
+
+        return next;
     }
 
     void publish(long sequence)
     {
-        cursor_ = sequence;
+        cursor_.value.store(sequence, std::memory_order_release);
+
+        if (blocking_wait_)
+        {
+            // Orders the cursor store before the waiter check: a consumer
+            // either sees the new cursor or is seen here (see
+            // wait_for_publish()). One relaxed load when nobody is parked.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters_.load(std::memory_order_relaxed) != 0)
+            {
+                wake_waiters();
+            }
+        }
     }
-    
+
     long cursor() const
     {
-        return cursor_.load();
+        return cursor_.value.load(std::memory_order_acquire);
+    }
+
+    // Called before the ring starts if any consumer uses a blocking wait
+    // strategy; without it publish() never looks at parked consumers.
+    void enable_blocking_wait()
+    {
+        blocking_wait_ = true;
     }
+
+    // Park the calling consumer until something is published after it
+    // registered, or until wake_waiters(). Returns the cursor, which may
+    // still be below sequence.
+    long wait_for_publish(long sequence, const std::atomic<bool>& running)
+    {
+        // Read the epoch before the last check of the cursor: any publish
+        // or halt after that check bumps it, and then wait() returns at once.
+        const uint32_t epoch = wake_epoch_.load(std::memory_order_acquire);
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+
+        if (cursor_.value.load(std::memory_order_seq_cst) < sequence && running.load(std::memory_order_relaxed))
+        {
+            wake_epoch_.wait(epoch, std::memory_order_acquire);
+        }
+
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return cursor();
+    }
+
+    // Wake every parked consumer, e.g. after halting them
+    void wake_waiters()
+    {
+        wake_epoch_.fetch_add(1, std::memory_order_release);
+        wake_epoch_.notify_all();
+    }
+
+    const ProducerMetrics& metrics() const
+    {
+        return metrics_;
+    }
+
+    // For the producer thread, the only writer
+    ProducerMetrics& metrics()
+    {
+        return metrics_;
+    }
+
+    // Start gating on sequence. It is moved to the current cursor, so the
+    // consumer owning it starts with the next event published.
+    /*
+        The sequence is set to the cursor both before and after the new set
+        is published (as LMAX does): before, so the producer never gates on a
+        stale value; after, because the producer may have moved on while it
+        was still scanning the old set.
+    */
+    void add_gating_sequence(std::atomic<long>* sequence)
+    {
+        std::lock_guard<std::mutex> lock(gating_mutex_);
+
+        sequence->store(cursor(), std::memory_order_release);
+
+        auto gating_sequences = std::make_unique<GatingSequences>(*gating_sequences_.load(std::memory_order_relaxed));
+        gating_sequences->push_back(sequence);
+        swap_gating_sequences(std::move(gating_sequences));
+
+        sequence->store(cursor(), std::memory_order_release);
+    }
+
+    // Stop gating on sequence. Returns false if it was not gating.
+    bool remove_gating_sequence(const std::atomic<long>* sequence)
+    {
+        std::lock_guard<std::mutex> lock(gating_mutex_);
+
+        auto gating_sequences = std::make_unique<GatingSequences>(*gating_sequences_.load(std::memory_order_relaxed));
+        auto it = std::find(gating_sequences->begin(), gating_sequences->end(), sequence);
+        if (it == gating_sequences->end())
+        {
+            return false;
+        }
+        gating_sequences->erase(it);
+        swap_gating_sequences(std::move(gating_sequences));
+        return true;
+    }
+
+    long minimum_gating_sequence(long minimum) const
+    {
+        for (const std::atomic<long>* sequence : *gating_sequences_.load(std::memory_order_acquire))
+        {
+            long value = sequence->load(std::memory_order_acquire);
+            if (value < minimum)
+            {
+                minimum = value;
+            }
+        }
+        return minimum;
+    }
+
 private:
-    std::atomic<long> cursor_;
+    using GatingSequences = std::vector<const std::atomic<long>*>;
+
+    // Called with gating_mutex_ held
+    void swap_gating_sequences(std::unique_ptr<GatingSequences> gating_sequences)
+    {
+        gating_sequences_.store(gating_sequences.get(), std::memory_order_release);
+        gating_sets_.push_back(std::move(gating_sequences));
+    }
+
+    // Producer private state
+    const long buffer_size_;
+    long next_;
+    long cached_gating_;
+    bool blocking_wait_ = false;
+    std::atomic<const GatingSequences*> gating_sequences_;
+
+    // Every gating set ever published, the current one last
+    std::mutex gating_mutex_;
+    std::vector<std::unique_ptr<GatingSequences>> gating_sets_;
+
+    ProducerMetrics metrics_;
+
+    // Shared with consumers
+    Sequence cursor_;
+
+    // Only touched by parked consumers and the producer waking them
+    alignas(kCacheLineSize) std::atomic<uint32_t> waiters_{0};
+    std::atomic<uint32_t> wake_epoch_{0};
 };
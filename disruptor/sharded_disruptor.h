@@ -0,0 +1,140 @@
+#pragma once
+
+#include "disruptor.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// K independent rings, each with its own producer, processor and thread.
+/*
+    -   publish(key, data) routes by a hash of the key, so every event for a
+        given key (e.g. an instrument id) lands on the same ring and is handled
+        by the same thread, in publish order. There is no ordering between
+        different keys.
+
+    -   Shards share nothing, so handlers scale across K cores as long as the
+        key stream spreads over the shards; stats() reports how evenly it does.
+
+    -   publish() must be called from a single thread (every shard has a
+        single producer sequencer).
+*/
+template <size_t N, typename WaitStrategyDerived>
+class ShardedDisruptor
+{
+public:
+    struct ShardStats
+    {
+        long cursor;    // last sequence published to the shard
+        long sequence;  // last sequence its processor has finished
+        long depth;     // events published but not handled yet
+    };
+
+    struct Stats
+    {
+        std::vector<ShardStats> shards;
+        long max_depth;
+        // Busiest shard's share of the events over a perfectly even share:
+        // 1.0 is a uniform spread, K means every event went to one shard.
+        double skew;
+    };
+
+    // handlers[i] sees exactly the keys that hash to shard i.
+    explicit ShardedDisruptor(const std::vector<EventHandler*>& handlers)
+    {
+        shards_.reserve(handlers.size());
+        for (size_t i = 0; i < handlers.size(); ++i)
+        {
+            shards_.push_back(std::make_unique<Shard>(static_cast<int>(i), handlers[i]));
+        }
+    }
+
+    void start()
+    {
+        for (auto& shard : shards_)
+        {
+            shard->disruptor.start();
+        }
+    }
+
+    void halt()
+    {
+        for (auto& shard : shards_)
+        {
+            shard->disruptor.halt();
+        }
+    }
+
+    long publish(uint64_t key, std::string_view data)
+    {
+        return shards_[shard_of(key)]->producer.publish(data);
+    }
+
+    size_t shard_count() const
+    {
+        return shards_.size();
+    }
+
+    size_t shard_of(uint64_t key) const
+    {
+        // Scramble the key (murmur3 finalizer) so dense ids spread over every
+        // shard, then map into [0, K) with a multiply instead of a modulo.
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return static_cast<size_t>((static_cast<unsigned __int128>(key) * shards_.size()) >> 64);
+    }
+
+    // Safe to call from any thread while the shards are running.
+    Stats stats() const
+    {
+        Stats stats{{}, 0, 0.0};
+        stats.shards.reserve(shards_.size());
+
+        long total = 0;
+        long busiest = 0;
+        for (const auto& shard : shards_)
+        {
+            ShardStats shard_stats;
+            shard_stats.sequence = shard->processor.sequence().load(std::memory_order_acquire);
+            shard_stats.cursor = shard->disruptor.cursor();
+            shard_stats.depth = std::max(0L, shard_stats.cursor - shard_stats.sequence);
+            stats.shards.push_back(shard_stats);
+
+            stats.max_depth = std::max(stats.max_depth, shard_stats.depth);
+            total += shard_stats.cursor + 1;
+            busiest = std::max(busiest, shard_stats.cursor + 1);
+        }
+
+        if (total > 0)
+        {
+            stats.skew = static_cast<double>(busiest) * shards_.size() / total;
+        }
+        return stats;
+    }
+
+private:
+    struct Shard
+    {
+        Shard(int id, EventHandler* handler)
+            : ring_buffer(std::make_shared<RingBuffer<N>>()),
+            producer(ring_buffer, nullptr),
+            processor(ring_buffer, nullptr, id, handler),
+            processors{&processor},
+            producers{&producer},
+            disruptor(processors, producers)
+        {
+        }
+
+        std::shared_ptr<RingBuffer<N>> ring_buffer;
+        Producer<N> producer;
+        EventProcessor<N, WaitStrategyDerived> processor;
+        std::vector<EventProcessor<N, WaitStrategyDerived>*> processors;
+        std::vector<Producer<N>*> producers;
+        Disruptor<N, WaitStrategyDerived> disruptor;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "sequence.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer single-consumer queue
+/*
+    -   head_ is only written by the producer, tail_ only by the consumer,
+        each on its own cache line.
+
+    -   Each side keeps a private copy of the other side's index and only
+        reloads the shared one when the copy says the queue is full (or
+        empty), so in steady state push and pop touch no shared cache line
+        besides the slot itself.
+*/
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N > 0 && ((N & (N - 1)) == 0), "SpscQueue requires N to be a power of two");
+
+public:
+    // Never blocks: returns false when the queue is full.
+    bool try_push(const T& value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ == N)
+        {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ == N)
+            {
+                return false;
+            }
+        }
+
+        buffer_[head & (N - 1)] = value;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == cached_head_)
+        {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail == cached_head_)
+            {
+                return false;
+            }
+        }
+
+        value = buffer_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Producer side
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+
+    // Consumer side
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+
+    alignas(kCacheLineSize) std::array<T, N> buffer_;
+};
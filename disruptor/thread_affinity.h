@@ -0,0 +1,20 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+// Pin the calling thread to one CPU, so a busy-polling consumer keeps its
+// core and its caches. Returns false if the CPU does not exist or is not
+// allowed for this process (e.g. outside the cgroup's cpuset).
+inline bool pin_current_thread(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+    {
+        return false;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
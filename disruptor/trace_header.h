@@ -0,0 +1,21 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t kMaxTraceStages = 4;
+
+// TSC stamps of one sampled event on its way through the ring. Kept in
+// TraceHeaders beside the ring, not in the event, see tracer.h.
+struct TraceHeader
+{
+    struct Stage
+    {
+        uint64_t enter_tsc;
+        uint64_t exit_tsc;
+    };
+
+    uint64_t publish_tsc;
+    std::array<Stage, kMaxTraceStages> stages;
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "metrics.h"
+#include "spsc_queue.h"
+#include "trace_header.h"
+#include "tsc.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sampled end to end tracing
+/*
+    -   TraceSampler picks 1 in every `one_in` sequences (a power of two), so
+        the producer and every stage agree on which events are traced without
+        passing a flag around: it is a mask test on the sequence.
+
+    -   The headers live beside the ring, in TraceHeaders, one per sampled
+        sequence in flight: events carry no trace state, so a ring that is
+        not traced pays nothing for it, not even slot size. The producer
+        stamps the publish TSC into the sequence's header. Each traced stage
+        stamps its own enter/exit TSC into it around the handler, where
+        stages downstream of it can read them, and pushes a TraceRecord to
+        its own TraceSink, an SPSC queue. A full sink drops the record
+        rather than stall the ring.
+
+    -   A record only holds the stage's own stamps: parallel stages write
+        their header entries concurrently, so copying the whole header
+        would race. Records of one message share its sequence; join on it
+        for the full breakdown.
+
+    -   Tracer's thread drains every sink in the background, converts TSC to
+        nanoseconds and writes the records in batches.
+*/
+class TraceSampler
+{
+public:
+    TraceSampler() = default;
+
+    // one_in == 0 samples nothing
+    explicit TraceSampler(uint64_t one_in) : enabled_(one_in > 0), mask_(one_in - 1)
+    {
+        if (enabled_ && (one_in & mask_) != 0)
+        {
+            throw std::invalid_argument("TraceSampler: one_in must be a power of two");
+        }
+    }
+
+    bool sampled(long sequence) const
+    {
+        return enabled_ && (static_cast<uint64_t>(sequence) & mask_) == 0;
+    }
+
+    // 0 if nothing is sampled
+    uint64_t one_in() const
+    {
+        return enabled_ ? mask_ + 1 : 0;
+    }
+
+private:
+    bool enabled_ = false;
+    uint64_t mask_ = 0;
+};
+
+// The TraceHeaders of a ring's sampled sequences, shared by its producer
+// and traced stages
+/*
+    Sampled sequences are multiples of one_in, and at most ring_size
+    sequences are in flight, so ring_size / one_in headers (at least one)
+    give every sampled sequence in flight its own. A header is reused once
+    its sequence has left the ring, as the slot is.
+*/
+class TraceHeaders
+{
+public:
+    // Throws std::invalid_argument if sampler samples nothing
+    TraceHeaders(size_t ring_size, TraceSampler sampler)
+        : sampler_(sampler), shift_(sampler.one_in() ? std::countr_zero(sampler.one_in()) : 0),
+          headers_(std::bit_ceil(std::max<size_t>(ring_size >> shift_, 1))), mask_(headers_.size() - 1)
+    {
+        if (sampler.one_in() == 0)
+        {
+            throw std::invalid_argument("TraceHeaders: the sampler samples nothing");
+        }
+    }
+
+    bool sampled(long sequence) const
+    {
+        return sampler_.sampled(sequence);
+    }
+
+    TraceSampler sampler() const
+    {
+        return sampler_;
+    }
+
+    // sequence must be sampled
+    TraceHeader& operator[](long sequence)
+    {
+        return headers_[(static_cast<uint64_t>(sequence) >> shift_) & mask_];
+    }
+
+private:
+    TraceSampler sampler_;
+    int shift_;
+    std::vector<TraceHeader> headers_;
+    size_t mask_;
+};
+
+struct TraceRecord
+{
+    long sequence;
+    int stage;
+    uint64_t publish_tsc;
+    TraceHeader::Stage stamps;
+};
+
+class TraceSink
+{
+public:
+    // Called by the stage's thread only
+    void push(const TraceRecord& record)
+    {
+        if (!queue_.try_push(record))
+        {
+            dropped_.add();
+        }
+    }
+
+    bool pop(TraceRecord& record)
+    {
+        return queue_.try_pop(record);
+    }
+
+    uint64_t dropped() const
+    {
+        return dropped_.load();
+    }
+
+private:
+    SpscQueue<TraceRecord, 4096> queue_;
+    MetricCounter dropped_;
+};
+
+class Tracer
+{
+public:
+    explicit Tracer(std::ostream& out, std::chrono::microseconds drain_interval = std::chrono::milliseconds(1))
+        : out_(out), drain_interval_(drain_interval)
+    {
+    }
+
+    ~Tracer()
+    {
+        stop();
+    }
+
+    // One sink per traced stage. Add every sink before start().
+    TraceSink& add_sink()
+    {
+        sinks_.push_back(std::make_unique<TraceSink>());
+        return *sinks_.back();
+    }
+
+    void start()
+    {
+        running_.store(true, std::memory_order_relaxed);
+        writer_ = std::thread([this]() {
+            while (running_.load(std::memory_order_relaxed))
+            {
+                drain();
+                std::this_thread::sleep_for(drain_interval_);
+            }
+            drain();
+        });
+    }
+
+    // Writes whatever is still queued, then joins the writer
+    void stop()
+    {
+        running_.store(false, std::memory_order_relaxed);
+        if (writer_.joinable())
+        {
+            writer_.join();
+        }
+    }
+
+private:
+    void drain()
+    {
+        std::string batch;
+        TraceRecord record;
+        for (auto& sink : sinks_)
+        {
+            while (sink->pop(record))
+            {
+                format(record, batch);
+            }
+        }
+
+        if (!batch.empty())
+        {
+            out_.write(batch.data(), batch.size());
+            out_.flush();
+        }
+    }
+
+    // sequence=<n> stage=<s> enter_ns=<publish to enter> exit_ns=<publish to exit>
+    static void format(const TraceRecord& record, std::string& out)
+    {
+        out += "sequence=" + std::to_string(record.sequence);
+        out += " stage=" + std::to_string(record.stage);
+        out += " enter_ns=" + std::to_string(static_cast<long>(tsc_to_nano(record.stamps.enter_tsc - record.publish_tsc)));
+        out += " exit_ns=" + std::to_string(static_cast<long>(tsc_to_nano(record.stamps.exit_tsc - record.publish_tsc)));
+        out += "\n";
+    }
+
+    std::ostream& out_;
+    std::chrono::microseconds drain_interval_;
+    std::vector<std::unique_ptr<TraceSink>> sinks_;
+    std::atomic<bool> running_{false};
+    std::thread writer_;
+};
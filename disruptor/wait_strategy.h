@@ -1,12 +1,74 @@
 #pragma once
 
+#include "sequencer.h"
+#include <atomic>
+#include <immintrin.h>
+#include <thread>
+
+// How an EventProcessor waits for the cursor to reach the next sequence
+/*
+    -   wait_for() may return before the sequence is available (after one
+        spin step, a spurious wake-up, or a halt); the processor re-checks
+        its running flag and the cursor and calls it again.
+
+    -   A derived strategy either only provides waitImpl(), one wait step
+        between polls of the cursor, or replaces wait_for_impl() entirely.
+
+    -   Blocking strategies set kBlocking so the Disruptor tells its
+        Sequencer to wake parked consumers on publish.
+
+    -   A stage behind other stages passes its barrier, the minimum of the
+        cursor and the upstream sequences. Once the cursor has reached the
+        sequence, only an upstream stage that is busy with it holds the
+        stage back, and nothing would wake it from a park: it pauses for
+        kDependencySpins polls, then yields (as LMAX does).
+*/
 template <typename WaitStrategyDerived>
 class WaitStrategy
 {
 public:
+    static constexpr bool kBlocking = false;
+    static constexpr int kDependencySpins = 1000;
+
     __attribute__((always_inline))
     void wait(){
-        static_cast<WaitStrategyDerived>(this)->waitImpl();
+        static_cast<WaitStrategyDerived*>(this)->waitImpl();
+    }
+
+    __attribute__((always_inline))
+    long wait_for(long sequence, Sequencer& sequencer, const std::atomic<bool>& running)
+    {
+        return static_cast<WaitStrategyDerived*>(this)->wait_for_impl(sequence, sequencer, running);
     }
-};
 
+    // Waits for barrier(), which never runs ahead of the cursor, to reach
+    // sequence; returns its last value
+    template <typename Barrier>
+    long wait_for(long sequence, Sequencer& sequencer, const std::atomic<bool>& running, Barrier&& barrier)
+    {
+        if (wait_for(sequence, sequencer, running) < sequence)
+        {
+            return barrier();
+        }
+
+        long available;
+        for (int i = 0; (available = barrier()) < sequence && running.load(std::memory_order_relaxed); ++i)
+        {
+            if (i < kDependencySpins)
+            {
+                _mm_pause();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+        return available;
+    }
+
+    long wait_for_impl(long, Sequencer& sequencer, const std::atomic<bool>&)
+    {
+        wait();
+        return sequencer.cursor();
+    }
+};